@@ -0,0 +1,350 @@
+// Google Benchmark suite of ObservableTree: root and path updates with many
+// observed paths, slot fan-out, path parsing and connection churn, against
+// the json11, property tree and Node traits. Each benchmark reports the heap
+// allocations per iteration.
+#include <benchmark/benchmark.h>
+#include <otree/Node.h>
+#include <otree/ObservableTree.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../test/Json11Trait.h"
+#include "../test/PtreeTrait.h"
+
+using namespace otree;
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+}  // namespace
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+// Counts the allocations of the timed loop, the constructor is meant to run
+// right before it
+class AllocationCounter {
+ public:
+  explicit AllocationCounter(benchmark::State &state)
+      : state_{state}, start_{allocations.load()} {}
+  ~AllocationCounter() {
+    state_.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(allocations.load() - start_),
+        benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  benchmark::State &state_;
+  size_t start_;
+};
+
+std::vector<std::string> leafKeys(int width, int depth) {
+  auto keys = std::vector<std::string>{""};
+  for (int level = 0; level < depth; ++level) {
+    auto next = std::vector<std::string>{};
+    for (const auto &prefix : keys) {
+      for (int i = 0; i < width; ++i) {
+        next.push_back((prefix.empty() ? "" : prefix + "/") + "k" +
+                       std::to_string(i));
+      }
+    }
+    keys = std::move(next);
+  }
+  return keys;
+}
+
+struct Json11Backend {
+  using Tree = ObservableTree<json11::Json, Json11Trait>;
+
+  static json11::Json makeDocument(int width, int depth, int value) {
+    if (depth == 0) {
+      return value;
+    }
+    auto items = json11::Json::object{};
+    for (int i = 0; i < width; ++i) {
+      items["k" + std::to_string(i)] = makeDocument(width, depth - 1, value);
+    }
+    return items;
+  }
+
+  static json11::Json makeValue(int value) { return value; }
+  static Tree::PathType makePath(const std::string &path) { return path; }
+};
+
+struct PtreeBackend {
+  using Tree = ObservableTree<PtreeTrait::NodeType, PtreeTrait,
+                              PtreeTrait::PathType, PtreeTrait::KeyType>;
+
+  static pt::ptree makeDocument(int width, int depth, int value) {
+    auto doc = pt::ptree{};
+    for (const auto &path : leafKeys(width, depth)) {
+      doc.put(makePath(path), value);
+    }
+    return doc;
+  }
+
+  static pt::ptree makeValue(int value) {
+    auto node = pt::ptree{};
+    node.put_value(value);
+    return node;
+  }
+
+  static Tree::PathType makePath(const std::string &path) {
+    return {path, '/'};
+  }
+};
+
+struct NodeBackend {
+  using Tree = ObservableTree<Node, NodeTrait, InternedPath, InternedKey>;
+
+  static Node makeDocument(int width, int depth, int value) {
+    if (depth == 0) {
+      return value;
+    }
+    auto node = Node::object();
+    for (int i = 0; i < width; ++i) {
+      node.set("k" + std::to_string(i), makeDocument(width, depth - 1, value));
+    }
+    return node;
+  }
+
+  static Node makeValue(int value) { return value; }
+  static Tree::PathType makePath(const std::string &path) { return path; }
+};
+
+template <class Tree>
+using ConnectionList = std::vector<decltype(
+    std::declval<typename Tree::SignalPtrType &>()->connect(nullptr))>;
+
+template <class Backend>
+ConnectionList<typename Backend::Tree> observeLeaves(
+    typename Backend::Tree &tree, int width, int depth) {
+  auto connections = ConnectionList<typename Backend::Tree>{};
+  for (const auto &path : leafKeys(width, depth)) {
+    connections.push_back(
+        tree.modificationSignal(Backend::makePath(path))
+            ->connect([](const auto &, const auto &newNode) {
+              benchmark::DoNotOptimize(&newNode);
+            }));
+  }
+  return connections;
+}
+
+// Root updates alternating between two documents whose every leaf is
+// observed, args: width, depth
+template <class Backend>
+void SetRoot(benchmark::State &state) {
+  auto width = static_cast<int>(state.range(0));
+  auto depth = static_cast<int>(state.range(1));
+  auto tree = typename Backend::Tree{};
+  auto connections = observeLeaves<Backend>(tree, width, depth);
+  auto doc1 = Backend::makeDocument(width, depth, 1);
+  auto doc2 = Backend::makeDocument(width, depth, 2);
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    tree.set(doc1);
+    tree.set(doc2);
+  }
+  state.counters["observed"] = static_cast<double>(connections.size());
+}
+
+// Fixed threads running the tasks of parallel diffs
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i) {
+      threads_.emplace_back([this] { run(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      auto lock = std::lock_guard<std::mutex>{mutex_};
+      stopped_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  Executor executor() {
+    return [this](std::function<void()> fn) {
+      {
+        auto lock = std::lock_guard<std::mutex>{mutex_};
+        tasks_.push_back(std::move(fn));
+      }
+      wakeup_.notify_one();
+    };
+  }
+
+ private:
+  void run() {
+    auto lock = std::unique_lock<std::mutex>{mutex_};
+    while (true) {
+      wakeup_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      auto fn = std::move(tasks_.front());
+      tasks_.pop_front();
+      lock.unlock();
+      fn();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopped_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// SetRoot with the top level diffed in parallel by all cores, args: width,
+// depth
+template <class Backend>
+void SetRootParallel(benchmark::State &state) {
+  auto width = static_cast<int>(state.range(0));
+  auto depth = static_cast<int>(state.range(1));
+  auto workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  auto pool = ThreadPool{workers};
+  auto tree = typename Backend::Tree{};
+  tree.setParallelDiff({pool.executor(), workers, 1});
+  auto connections = observeLeaves<Backend>(tree, width, depth);
+  auto doc1 = Backend::makeDocument(width, depth, 1);
+  auto doc2 = Backend::makeDocument(width, depth, 2);
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    tree.set(doc1);
+    tree.set(doc2);
+  }
+}
+
+// Updates of one observed leaf among all observed leaves, args: width, depth
+template <class Backend>
+void SetPath(benchmark::State &state) {
+  auto width = static_cast<int>(state.range(0));
+  auto depth = static_cast<int>(state.range(1));
+  auto tree = typename Backend::Tree{};
+  auto connections = observeLeaves<Backend>(tree, width, depth);
+  tree.set(Backend::makeDocument(width, depth, 0));
+  auto path = Backend::makePath(leafKeys(width, depth).back());
+  auto value1 = Backend::makeValue(1);
+  auto value2 = Backend::makeValue(2);
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    tree.set(path, value1);
+    tree.set(path, value2);
+  }
+}
+
+// Root updates notifying one path with many slots, arg: slots
+template <class Backend>
+void FanOut(benchmark::State &state) {
+  auto tree = typename Backend::Tree{};
+  auto signal = tree.modificationSignal(Backend::makePath("k0"));
+  auto connections = ConnectionList<typename Backend::Tree>{};
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    connections.push_back(
+        signal->connect([](const auto &, const auto &newNode) {
+          benchmark::DoNotOptimize(&newNode);
+        }));
+  }
+  auto doc1 = Backend::makeDocument(1, 1, 1);
+  auto doc2 = Backend::makeDocument(1, 1, 2);
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    tree.set(doc1);
+    tree.set(doc2);
+  }
+}
+
+// Connecting and disconnecting a slot of a path that keeps another slot
+template <class Backend>
+void ConnectChurn(benchmark::State &state) {
+  auto tree = typename Backend::Tree{};
+  auto signal = tree.modificationSignal(Backend::makePath("k0/k1"));
+  auto kept = signal->connect([](const auto &, const auto &) {});
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    auto connection = signal->connect([](const auto &, const auto &) {});
+    connection.disconnect();
+  }
+}
+
+void PathParse(benchmark::State &state) {
+  auto str = leafKeys(2, static_cast<int>(state.range(0))).back();
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    auto path = Path{str};
+    benchmark::DoNotOptimize(path);
+  }
+}
+
+// Path from a literal split at compile time, against PathParse/6
+void StaticPathConvert(benchmark::State &state) {
+  constexpr auto staticPath = StaticPath{"k0/k1/k0/k1/k0/k1"};
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    auto path = Path{staticPath};
+    benchmark::DoNotOptimize(path);
+  }
+}
+
+void PathCompare(benchmark::State &state) {
+  auto keys = leafKeys(2, static_cast<int>(state.range(0)));
+  auto path1 = Path{keys.front()};
+  auto path2 = Path{keys.back()};
+  auto counter = AllocationCounter{state};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(path1 == path2);
+    benchmark::DoNotOptimize(path1 < path2);
+  }
+}
+
+void shapes(benchmark::internal::Benchmark *bench) {
+  bench->Args({8, 2})->Args({4, 4})->Args({16, 2})->Args({8, 3});
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(SetRoot, Json11Backend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetRoot, PtreeBackend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetRoot, NodeBackend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetRootParallel, Json11Backend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetRootParallel, PtreeBackend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetRootParallel, NodeBackend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetPath, Json11Backend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetPath, PtreeBackend)->Apply(shapes);
+BENCHMARK_TEMPLATE(SetPath, NodeBackend)->Apply(shapes);
+BENCHMARK_TEMPLATE(FanOut, Json11Backend)->Arg(1)->Arg(10)->Arg(1000);
+BENCHMARK_TEMPLATE(FanOut, PtreeBackend)->Arg(1)->Arg(10)->Arg(1000);
+BENCHMARK_TEMPLATE(FanOut, NodeBackend)->Arg(1)->Arg(10)->Arg(1000);
+BENCHMARK_TEMPLATE(ConnectChurn, Json11Backend);
+BENCHMARK_TEMPLATE(ConnectChurn, PtreeBackend);
+BENCHMARK_TEMPLATE(ConnectChurn, NodeBackend);
+BENCHMARK(PathParse)->Arg(2)->Arg(6)->Arg(12);
+BENCHMARK(StaticPathConvert);
+BENCHMARK(PathCompare)->Arg(2)->Arg(6)->Arg(12);
+
+BENCHMARK_MAIN();
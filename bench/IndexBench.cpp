@@ -0,0 +1,88 @@
+// Compares the subscription index layouts of ObservableTree on root updates
+// with many observed paths.
+#include <otree/ObservableTree.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../test/PtreeTrait.h"
+
+using namespace otree;
+
+template <class Index>
+using BenchTree =
+    ObservableTree<PtreeTrait::NodeType, PtreeTrait, PtreeTrait::PathType,
+                   PtreeTrait::KeyType, NoEffectMutex, Index>;
+
+// Split on '/' like the paths of the subscription index
+PtreeTrait::PathType leafPath(int i, int j, int k) {
+  return {"k" + std::to_string(i) + "/k" + std::to_string(j) + "/k" +
+              std::to_string(k),
+          '/'};
+}
+
+// Leaves whose value differs between the two documents of a run
+bool isChanging(int i, int j, int k) { return (i + j + k) % 7 == 0; }
+
+pt::ptree makeDocument(int width, int value) {
+  auto doc = pt::ptree{};
+  for (int i = 0; i < width; ++i) {
+    for (int j = 0; j < width; ++j) {
+      for (int k = 0; k < width; ++k) {
+        doc.put(leafPath(i, j, k), isChanging(i, j, k) ? value : 0);
+      }
+    }
+  }
+  return doc;
+}
+
+// Microseconds per root update. Throws unless every update notified the
+// slots of all the changing leaves.
+template <class Index>
+double run(int width, int iterations) {
+  auto tree = BenchTree<Index>{};
+  auto connections = std::vector<decltype(
+      tree.modificationSignal("").get()->connect(nullptr))>{};
+  auto notified = size_t{0};
+  auto changing = size_t{0};
+  for (int i = 0; i < width; ++i) {
+    for (int j = 0; j < width; ++j) {
+      for (int k = 0; k < width; ++k) {
+        changing += isChanging(i, j, k);
+        connections.push_back(
+            tree.modificationSignal(leafPath(i, j, k))
+                ->connect([&notified](const auto &, const auto &) {
+                  ++notified;
+                }));
+      }
+    }
+  }
+  auto doc1 = makeDocument(width, 1);
+  auto doc2 = makeDocument(width, 2);
+  tree.set(doc2);
+  notified = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    tree.set(doc1);
+    tree.set(doc2);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  if (!changing || notified != changing * 2 * iterations) {
+    throw std::runtime_error{"the observed leaves were not notified"};
+  }
+  return std::chrono::duration<double, std::micro>(elapsed).count() /
+         (2.0 * iterations);
+}
+
+int main() {
+  for (auto width : {4, 8, 12}) {
+    auto iterations = 2000 / width;
+    std::cout << width * width * width << " observed paths: map "
+              << run<MapIndex>(width, iterations) << " us/set, flat "
+              << run<FlatIndex>(width, iterations) << " us/set\n";
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Compares the write throughput of ObservableTree and ShardedObservableTree
+// with one writer thread per top-level branch.
+#include <otree/ObservableTree.h>
+#include <otree/ShardedObservableTree.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../test/PtreeTrait.h"
+
+using namespace otree;
+
+using SingleTree =
+    ObservableTree<PtreeTrait::NodeType, PtreeTrait, PtreeTrait::PathType,
+                   PtreeTrait::KeyType, std::mutex>;
+using ShardedTree =
+    ShardedObservableTree<PtreeTrait::NodeType, PtreeTrait,
+                          PtreeTrait::PathType, PtreeTrait::KeyType>;
+
+// Split on '/' like the paths of the subscription index
+PtreeTrait::PathType valuePath(int branch) {
+  return {"b" + std::to_string(branch) + "/value", '/'};
+}
+
+// Sets per millisecond. Throws unless every set notified its slot.
+template <class Tree>
+double run(Tree &tree, int writers, int iterations) {
+  auto connections = std::vector<decltype(
+      tree.modificationSignal("").get()->connect(nullptr))>{};
+  auto notified = std::atomic<long>{0};
+  for (int i = 0; i < writers; ++i) {
+    auto slot = [&notified](const auto &, const auto &) {
+      notified.fetch_add(1, std::memory_order_relaxed);
+    };
+    connections.push_back(tree.modificationSignal(valuePath(i))->connect(slot));
+  }
+  auto start = std::chrono::steady_clock::now();
+  auto threads = std::vector<std::thread>{};
+  for (int i = 0; i < writers; ++i) {
+    threads.emplace_back([&tree, i, iterations] {
+      auto path = valuePath(i);
+      auto value = pt::ptree{};
+      for (int k = 0; k < iterations; ++k) {
+        value.put_value(k);
+        tree.set(path, value);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  if (notified != static_cast<long>(writers) * iterations) {
+    throw std::runtime_error{"the observed values were not notified"};
+  }
+  return writers * iterations /
+         std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+int main() {
+  auto maxWriters = static_cast<int>(std::thread::hardware_concurrency());
+  for (int writers = 1; writers <= std::max(maxWriters, 1); writers *= 2) {
+    auto single = SingleTree{};
+    auto sharded = ShardedTree{static_cast<size_t>(writers) * 4};
+    std::cout << writers << " writers: single "
+              << run(single, writers, 20000) << " sets/ms, sharded "
+              << run(sharded, writers, 20000) << " sets/ms\n";
+  }
+  return 0;
+}
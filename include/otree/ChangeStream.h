@@ -0,0 +1,258 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#if !defined(__cpp_impl_coroutine)
+#error "otree/ChangeStream.h needs C++20 coroutines"
+#endif
+
+#include <algorithm>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace otree {
+
+// What a full stream buffer does with a new change. DropOldest: the oldest
+// buffered change is dropped. Coalesce: the change replaces the new node of
+// the most recent buffered change of the same path, which keeps its old node
+// and place, the oldest change is dropped if there is none.
+enum class Overflow : char { DropOldest, Coalesce };
+
+struct StreamOptions {
+  size_t capacity = 64;
+  Overflow overflow = Overflow::DropOldest;
+  // Resumes the consumer, if empty on the thread notifying the change once
+  // its tree update released the tree lock
+  Executor executor = {};
+};
+
+namespace detail {
+
+// Ring buffer between the slot of a stream and its single consumer. The slot
+// only holds a short lock to buffer a change, it never waits for the consumer.
+template <class Tree>
+class StreamState {
+  using ChangeType = Change<Tree>;
+  using PathType = typename Tree::PathType;
+  using NodeType = typename Tree::NodeType;
+
+ public:
+  explicit StreamState(StreamOptions options)
+      : ring_(std::max<size_t>(options.capacity, 1)),
+        overflow_{options.overflow},
+        executor_{std::move(options.executor)} {}
+
+  void push(const PathType &path, const NodeType &oldNode,
+            const NodeType &newNode) {
+    auto waiter = std::coroutine_handle<>{};
+    {
+      LockGuard lock(mutex_);
+      if (closed_) {
+        return;
+      }
+      if (size_ == ring_.size()) {
+        ++dropped_;
+        if (overflow_ == Overflow::Coalesce && coalesce(path, newNode)) {
+          return;
+        }
+        head_ = (head_ + 1) % ring_.size();
+        --size_;
+      }
+      auto &change = ring_[(head_ + size_++) % ring_.size()];
+      change.path = path;
+      change.oldNode = oldNode;
+      change.newNode = newNode;
+      waiter = std::exchange(waiter_, nullptr);
+    }
+    resume(waiter);
+  }
+
+  void close() {
+    auto waiter = std::coroutine_handle<>{};
+    {
+      LockGuard lock(mutex_);
+      closed_ = true;
+      waiter = std::exchange(waiter_, nullptr);
+    }
+    resume(waiter);
+  }
+
+  bool ready() {
+    LockGuard lock(mutex_);
+    return size_ || closed_;
+  }
+
+  // false if a change or the close arrived since ready()
+  bool suspend(std::coroutine_handle<> waiter) {
+    LockGuard lock(mutex_);
+    if (size_ || closed_) {
+      return false;
+    }
+    waiter_ = waiter;
+    return true;
+  }
+
+  // The coroutine awaiting is destroyed
+  void cancel(std::coroutine_handle<> waiter) {
+    LockGuard lock(mutex_);
+    if (waiter_ == waiter) {
+      waiter_ = nullptr;
+    }
+  }
+
+  std::optional<ChangeType> pop() {
+    LockGuard lock(mutex_);
+    if (!size_) {
+      return std::nullopt;
+    }
+    auto change = std::move(ring_[head_]);
+    head_ = (head_ + 1) % ring_.size();
+    --size_;
+    return change;
+  }
+
+  size_t dropped() {
+    LockGuard lock(mutex_);
+    return dropped_;
+  }
+
+ private:
+  bool coalesce(const PathType &path, const NodeType &newNode) {
+    if constexpr (IsEqualityComparable<PathType>::value) {
+      for (size_t i = size_; i-- > 0;) {
+        auto &change = ring_[(head_ + i) % ring_.size()];
+        if (change.path == path) {
+          change.newNode = newNode;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void resume(std::coroutine_handle<> waiter) {
+    if (!waiter) {
+      return;
+    }
+    if (executor_) {
+      executor_([waiter] { waiter.resume(); });
+    } else {
+      detail::AfterUpdate::post([waiter] { waiter.resume(); });
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<ChangeType> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  size_t dropped_ = 0;
+  Overflow overflow_;
+  Executor executor_;
+  std::coroutine_handle<> waiter_;
+  bool closed_ = false;
+};
+
+}  // namespace detail
+
+// Changes of one subscription path, awaited by a single coroutine instead of
+// connecting a slot. The changes notified while nobody awaits are buffered,
+// up to `capacity` of them, writers never wait for the consumer.
+//
+//   auto stream = tree.changes("a/b");
+//   while (auto change = co_await stream.next()) {
+//     use(change->path, change->oldNode, change->newNode);
+//   }
+//
+// next() returns nullopt once the stream is closed and its buffer is empty.
+// Closing or destroying the stream disconnects it. Without an executor the
+// consumer runs on the notifying thread after the tree lock is released, so
+// it can read and write the tree, until it suspends again.
+template <class Tree>
+class ChangeStream {
+  using StateType = detail::StreamState<Tree>;
+
+ public:
+  using ChangeType = Change<Tree>;
+  using SignalPtrType = typename Tree::SignalPtrType;
+  using ConnectionType =
+      decltype(std::declval<SignalPtrType &>()->connect(nullptr));
+
+  class NextAwaiter {
+   public:
+    NextAwaiter(NextAwaiter &&other)
+        : state_{other.state_}, waiter_{std::exchange(other.waiter_, {})} {}
+    NextAwaiter &operator=(NextAwaiter &&) = delete;
+    // Destroyed with a suspended coroutine
+    ~NextAwaiter() {
+      if (waiter_) {
+        state_->cancel(waiter_);
+      }
+    }
+
+    bool await_ready() { return state_->ready(); }
+    bool await_suspend(std::coroutine_handle<> waiter) {
+      if (state_->suspend(waiter)) {
+        waiter_ = waiter;
+        return true;
+      }
+      return false;
+    }
+    std::optional<ChangeType> await_resume() {
+      waiter_ = nullptr;
+      return state_->pop();
+    }
+
+   private:
+    friend class ChangeStream;
+    explicit NextAwaiter(StateType *state) : state_{state} {}
+
+    StateType *state_;
+    std::coroutine_handle<> waiter_;
+  };
+
+  ChangeStream(SignalPtrType signal, StreamOptions options = {})
+      : signal_{std::move(signal)},
+        state_{std::make_shared<StateType>(std::move(options))},
+        connection_{signal_->connect(
+            [state = state_](const typename Tree::PathType &path,
+                             const typename Tree::NodeType &oldNode,
+                             const typename Tree::NodeType &newNode) {
+              state->push(path, oldNode, newNode);
+            })} {}
+
+  ChangeStream(ChangeStream &&) = default;
+  ChangeStream &operator=(ChangeStream &&other) {
+    close();
+    signal_ = std::move(other.signal_);
+    state_ = std::move(other.state_);
+    connection_ = std::move(other.connection_);
+    return *this;
+  }
+
+  ~ChangeStream() { close(); }
+
+  NextAwaiter next() { return NextAwaiter{state_.get()}; }
+
+  // Resumes a pending next() with nullopt once the buffer is drained
+  void close() {
+    if (state_) {
+      auto connection = std::move(connection_);
+      connection.disconnect();
+      state_->close();
+    }
+  }
+
+  // Changes dropped or coalesced because the buffer was full
+  size_t dropped() const { return state_ ? state_->dropped() : 0; }
+
+ private:
+  SignalPtrType signal_;
+  std::shared_ptr<StateType> state_;
+  ConnectionType connection_;
+};
+
+}  // namespace otree
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace otree {
+
+// Runs scheduled functions once they are due, either on its own thread or on
+// the threads calling tick()
+class CoalescingTimer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Mode : char { Thread, Manual };
+
+  explicit CoalescingTimer(Mode mode = Mode::Thread) {
+    if (mode == Mode::Thread) {
+      thread_ = std::thread{[this] { run(); }};
+    }
+  }
+
+  ~CoalescingTimer() {
+    {
+      LockGuard lock(mutex_);
+      stopped_ = true;
+    }
+    wakeup_.notify_one();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  CoalescingTimer(const CoalescingTimer &) = delete;
+  CoalescingTimer &operator=(const CoalescingTimer &) = delete;
+
+  // Timer of the Coalesce adaptors that do not name one, its thread runs
+  // until the program exits
+  static CoalescingTimer &instance() {
+    static CoalescingTimer timer;
+    return timer;
+  }
+
+  void schedule(Clock::time_point due, std::function<void()> fn) {
+    {
+      LockGuard lock(mutex_);
+      due_.emplace(due, std::move(fn));
+    }
+    wakeup_.notify_one();
+  }
+
+  // Runs the functions due at `now`, returns how many ran
+  size_t tick(Clock::time_point now = Clock::now()) {
+    auto batch = std::vector<std::function<void()>>{};
+    {
+      LockGuard lock(mutex_);
+      batch = takeDue(now);
+    }
+    for (auto &fn : batch) {
+      fn();
+    }
+    return batch.size();
+  }
+
+ private:
+  std::vector<std::function<void()>> takeDue(Clock::time_point now) {
+    auto batch = std::vector<std::function<void()>>{};
+    auto last = due_.upper_bound(now);
+    for (auto it = due_.begin(); it != last; ++it) {
+      batch.push_back(std::move(it->second));
+    }
+    due_.erase(due_.begin(), last);
+    return batch;
+  }
+
+  void run() {
+    auto lock = std::unique_lock<std::mutex>{mutex_};
+    while (!stopped_) {
+      if (due_.empty()) {
+        wakeup_.wait(lock);
+      } else if (auto next = due_.begin()->first; Clock::now() < next) {
+        wakeup_.wait_until(lock, next);
+      } else {
+        auto batch = takeDue(Clock::now());
+        lock.unlock();
+        for (auto &fn : batch) {
+          fn();
+        }
+        lock.lock();
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::multimap<Clock::time_point, std::function<void()>> due_;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+namespace detail {
+
+template <class T, class = void>
+struct IsLessThanComparable : std::false_type {};
+
+template <class T>
+struct IsLessThanComparable<
+    T, std::void_t<decltype(std::declval<const T &>() <
+                            std::declval<const T &>())>> : std::true_type {};
+
+// Orders the pending paths, paths that cannot be ordered are all equivalent
+template <class Path>
+struct PendingLess {
+  bool operator()(const Path &path1, const Path &path2) const {
+    if constexpr (IsLessThanComparable<Path>::value) {
+      return path1 < path2;
+    } else {
+      return false;
+    }
+  }
+};
+
+template <class Tree, class F>
+class CoalescedSlot
+    : public std::enable_shared_from_this<CoalescedSlot<Tree, F>> {
+  using PathType = typename Tree::PathType;
+  using NodeType = typename Tree::NodeType;
+
+  struct Pending {
+    NodeType oldNode;
+    NodeType newNode;
+  };
+
+  using PendingMap = std::map<PathType, Pending, PendingLess<PathType>>;
+
+ public:
+  CoalescedSlot(F &&fn, CoalescingTimer::Clock::duration interval,
+                Executor executor, CoalescingTimer &timer)
+      : fn_{std::move(fn)},
+        interval_{interval},
+        executor_{std::move(executor)},
+        timer_{timer} {}
+
+  // Keeps the first old node and the latest new node of each path, paths
+  // that cannot be ordered share one entry
+  void operator()(const PathType &path, const NodeType &oldNode,
+                  const NodeType &newNode) {
+    auto mustSchedule = false;
+    {
+      LockGuard lock(mutex_);
+      auto [it, inserted] =
+          pending_.try_emplace(path, Pending{oldNode, newNode});
+      if (!inserted) {
+        it->second.newNode = newNode;
+      }
+      mustSchedule = !scheduled_;
+      scheduled_ = true;
+    }
+    if (mustSchedule) {
+      schedule();
+    }
+  }
+
+ private:
+  void schedule() {
+    auto weak = this->weak_from_this();
+    timer_.schedule(CoalescingTimer::Clock::now() + interval_, [weak] {
+      if (auto self = weak.lock()) {
+        if (self->executor_) {
+          self->executor_([self] { self->deliver(); });
+        } else {
+          self->deliver();
+        }
+      }
+    });
+  }
+
+  // Paths are delivered in order. Changes arriving while the slot runs are
+  // delivered one interval later, so the slot never runs concurrently with
+  // itself.
+  void deliver() {
+    auto batch = PendingMap{};
+    {
+      LockGuard lock(mutex_);
+      batch.swap(pending_);
+    }
+    for (const auto &[path, change] : batch) {
+      if constexpr (std::is_invocable_v<F &, const PathType &,
+                                        const NodeType &, const NodeType &>) {
+        fn_(path, change.oldNode, change.newNode);
+      } else {
+        fn_(change.oldNode, change.newNode);
+      }
+    }
+    auto mustSchedule = false;
+    {
+      LockGuard lock(mutex_);
+      mustSchedule = scheduled_ = !pending_.empty();
+    }
+    if (mustSchedule) {
+      schedule();
+    }
+  }
+
+  F fn_;
+  CoalescingTimer::Clock::duration interval_;
+  Executor executor_;
+  CoalescingTimer &timer_;
+  std::mutex mutex_;
+  PendingMap pending_;
+  bool scheduled_ = false;
+};
+
+}  // namespace detail
+
+// Slot adaptor for paths changing faster than their observers need: of all
+// changes of a path within `interval` after the first one, the slot gets the
+// first old node and the latest new node, on the timer's thread or on the
+// executor if one is given. Changes not yet due when the slot is disconnected
+// are dropped.
+//
+//   signal->connect(slot, Coalesce{std::chrono::milliseconds{50}});
+struct Coalesce {
+  CoalescingTimer::Clock::duration interval;
+  Executor executor = {};
+  CoalescingTimer *timer = nullptr;
+
+  template <class Tree, class F>
+  auto wrap(F &&fn) const {
+    using SlotType = detail::CoalescedSlot<Tree, std::decay_t<F>>;
+    auto slot = std::make_shared<SlotType>(
+        std::decay_t<F>{std::forward<F>(fn)}, interval, executor,
+        timer ? *timer : CoalescingTimer::instance());
+    return [slot](const typename Tree::PathType &path,
+                  const typename Tree::NodeType &oldNode,
+                  const typename Tree::NodeType &newNode) {
+      (*slot)(path, oldNode, newNode);
+    };
+  }
+};
+
+}  // namespace otree
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace otree {
+
+// Process wide symbol table, a key is interned once and is then identified by
+// a 32 bit ID. Names are never released, so a name reference stays valid for
+// the lifetime of the process and can be read without locking.
+class KeyTable {
+ public:
+  using IDType = std::uint32_t;
+
+  static KeyTable &instance() {
+    static KeyTable table;
+    return table;
+  }
+
+  IDType intern(std::string_view key) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      if (auto it = ids_.find(key); it != ids_.end()) {
+        return it->second;
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (auto it = ids_.find(key); it != ids_.end()) {
+      return it->second;
+    }
+    auto id = size_;
+    auto &chunk = chunks_[id >> ChunkBits];
+    if (!chunk.load(std::memory_order_relaxed)) {
+      chunk.store(new std::string[ChunkSize], std::memory_order_release);
+    }
+    auto &name = chunk.load(std::memory_order_relaxed)[id & ChunkMask];
+    name = key;
+    ids_.emplace(name, id);
+    ++size_;
+    return id;
+  }
+
+  const std::string &name(IDType id) const {
+    return chunks_[id >> ChunkBits].load(
+        std::memory_order_acquire)[id & ChunkMask];
+  }
+
+ private:
+  static constexpr IDType ChunkBits = 12;
+  static constexpr IDType ChunkSize = 1u << ChunkBits;
+  static constexpr IDType ChunkMask = ChunkSize - 1;
+  static constexpr IDType MaxChunks = 1u << 16;
+
+  KeyTable() { intern({}); }
+
+  std::shared_mutex mutex_;
+  std::unordered_map<std::string_view, IDType> ids_;
+  std::array<std::atomic<std::string *>, MaxChunks> chunks_{};
+  IDType size_ = 0;
+};
+
+// Key interned in KeyTable: 4 bytes, compared and hashed by its ID. The ID 0
+// is the empty key.
+class InternedKey {
+ public:
+  using IDType = KeyTable::IDType;
+
+  InternedKey() = default;
+  InternedKey(std::string_view key) : id_{KeyTable::instance().intern(key)} {}
+  InternedKey(const std::string &key) : InternedKey{std::string_view{key}} {}
+  InternedKey(const char *key) : InternedKey{std::string_view{key}} {}
+
+  IDType id() const { return id_; }
+  const std::string &str() const { return KeyTable::instance().name(id_); }
+  operator const std::string &() const { return str(); }
+
+  bool operator==(const InternedKey &other) const { return id_ == other.id_; }
+  bool operator!=(const InternedKey &other) const { return id_ != other.id_; }
+  bool operator<(const InternedKey &other) const { return id_ < other.id_; }
+
+ private:
+  IDType id_ = 0;
+};
+
+namespace detail {
+
+// Vector of trivially copyable values that keeps up to N of them inline
+template <class T, std::size_t N>
+class SmallVector {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  SmallVector() = default;
+  SmallVector(const SmallVector &other) { assign(other.begin(), other.end()); }
+  SmallVector(SmallVector &&other) noexcept { steal(other); }
+  ~SmallVector() { release(); }
+
+  SmallVector &operator=(const SmallVector &other) {
+    if (this != &other) {
+      size_ = 0;
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+
+  SmallVector &operator=(SmallVector &&other) noexcept {
+    if (this != &other) {
+      release();
+      steal(other);
+    }
+    return *this;
+  }
+
+  void push_back(const T &value) {
+    if (size_ == capacity_) {
+      reserve(capacity_ * 2);
+    }
+    data()[size_++] = value;
+  }
+
+  void reserve(std::size_t capacity) {
+    if (capacity > capacity_) {
+      auto heap = new T[capacity];
+      std::memcpy(static_cast<void *>(heap), data(), size_ * sizeof(T));
+      release();
+      heap_ = heap;
+      capacity_ = static_cast<std::uint32_t>(capacity);
+    }
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T &operator[](std::size_t i) const { return data()[i]; }
+  const T &back() const { return data()[size_ - 1]; }
+
+  T *begin() { return data(); }
+  T *end() { return data() + size_; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + size_; }
+
+ private:
+  bool onHeap() const { return capacity_ > N; }
+  T *data() { return onHeap() ? heap_ : reinterpret_cast<T *>(inline_); }
+  const T *data() const {
+    return onHeap() ? heap_ : reinterpret_cast<const T *>(inline_);
+  }
+
+  void assign(const T *first, const T *last) {
+    reserve(static_cast<std::size_t>(last - first));
+    std::memcpy(static_cast<void *>(data()), first,
+                static_cast<std::size_t>(last - first) * sizeof(T));
+    size_ = static_cast<std::uint32_t>(last - first);
+  }
+
+  void steal(SmallVector &other) {
+    if (other.onHeap()) {
+      heap_ = other.heap_;
+      capacity_ = other.capacity_;
+      size_ = other.size_;
+      other.capacity_ = N;
+      other.size_ = 0;
+    } else {
+      capacity_ = N;
+      size_ = 0;
+      assign(other.begin(), other.end());
+    }
+  }
+
+  void release() {
+    if (onHeap()) {
+      delete[] heap_;
+      capacity_ = N;
+    }
+  }
+
+  std::uint32_t size_ = 0;
+  std::uint32_t capacity_ = N;
+  union {
+    T *heap_;
+    alignas(T) unsigned char inline_[N * sizeof(T)];
+  };
+};
+
+}  // namespace detail
+
+// Path of interned keys that keeps up to 6 keys inline and carries a
+// precomputed hash, so copying, comparing and hashing never touch the key
+// strings
+class InternedPath {
+ public:
+  using KeyType = InternedKey;
+  using Keys = detail::SmallVector<KeyType, 6>;
+  using Sep = char;
+  using iterator = Keys::const_iterator;
+  using const_iterator = Keys::const_iterator;
+
+  InternedPath() = default;
+
+  InternedPath(const std::vector<KeyType> &keys) {
+    for (const auto &key : keys) {
+      append(key);
+    }
+  }
+
+  InternedPath(const Path &path) {
+    for (const auto &key : path) {
+      append(KeyType{key});
+    }
+  }
+
+  template <std::size_t N>
+  InternedPath(const StaticPath<N> &path) {
+    for (auto key : path) {
+      append(KeyType{key});
+    }
+  }
+
+  template <class String>
+  InternedPath(const String &path, Sep sep = '/') {
+    detail::forEachKey(path, sep, [this](auto first, auto last) {
+      append(KeyType{std::string_view{&*first,
+                                      static_cast<std::size_t>(last - first)}});
+      return true;
+    });
+  }
+
+  const Keys &keys() const { return keys_; }
+  std::size_t size() const { return keys_.size(); }
+  std::size_t hash() const { return static_cast<std::size_t>(hash_); }
+
+  std::string toString(Sep sep = '/') const {
+    auto str = std::string{};
+    for (const auto &key : keys_) {
+      str += key.str() + sep;
+    }
+    if (!str.empty()) {
+      str.resize(str.size() - 1);
+    }
+    return str;
+  }
+
+  Path toPath() const {
+    auto keys = Path::Keys{};
+    for (const auto &key : keys_) {
+      keys.push_back(key.str());
+    }
+    return Path{std::move(keys)};
+  }
+
+  InternedPath operator/(const KeyType &key) const {
+    auto newPath = *this;
+    newPath.append(key);
+    return newPath;
+  }
+
+  InternedPath operator/(const InternedPath &path) const {
+    auto newPath = *this;
+    newPath.keys_.reserve(keys_.size() + path.keys_.size());
+    for (const auto &key : path.keys_) {
+      newPath.append(key);
+    }
+    return newPath;
+  }
+
+  bool operator==(const InternedPath &other) const {
+    return hash_ == other.hash_ && keys_.size() == other.keys_.size() &&
+           std::equal(keys_.begin(), keys_.end(), other.keys_.begin());
+  }
+  bool operator!=(const InternedPath &other) const {
+    return !(*this == other);
+  }
+  bool operator<(const InternedPath &other) const {
+    return std::lexicographical_compare(keys_.begin(), keys_.end(),
+                                        other.keys_.begin(),
+                                        other.keys_.end());
+  }
+
+  const_iterator begin() const { return keys_.begin(); }
+  const_iterator end() const { return keys_.end(); }
+
+ private:
+  void append(const KeyType &key) {
+    keys_.push_back(key);
+    hash_ = (hash_ ^ key.id()) * 0x100000001b3ull;
+  }
+
+  Keys keys_;
+  std::uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+}  // namespace otree
+
+namespace std {
+
+template <>
+struct hash<otree::InternedKey> {
+  size_t operator()(const otree::InternedKey &key) const { return key.id(); }
+};
+
+template <>
+struct hash<otree::InternedPath> {
+  size_t operator()(const otree::InternedPath &path) const {
+    return path.hash();
+  }
+};
+
+}  // namespace std
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <otree/InternedPath.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace otree {
+
+// Immutable tree node with structural sharing: null, bool, integer, double,
+// string or object. Scalars are stored inline, an object is a refcounted
+// vector of children sorted by interned key, shared by all copies of the node
+// and copied on the first write to a shared one. Copying a node is O(1), so is
+// comparing two copies and hashing an object, whose hash is kept up to date by
+// the writes.
+class Node {
+ public:
+  using KeyType = InternedKey;
+  using Child = std::pair<KeyType, Node>;
+  using Children = std::vector<Child>;
+  enum class Type : char { Null, Bool, Int, Double, String, Object };
+
+  Node() = default;
+  Node(std::nullptr_t) {}
+  Node(bool value) : value_{value} {}
+  template <class Int, std::enable_if_t<std::is_integral_v<Int> &&
+                                            !std::is_same_v<Int, bool>,
+                                        int> = 0>
+  Node(Int value) : value_{static_cast<std::int64_t>(value)} {}
+  Node(double value) : value_{value} {}
+  Node(std::string value) : value_{std::move(value)} {}
+  Node(const char *value) : value_{std::string{value}} {}
+  // Object, of the last child of each key
+  Node(std::initializer_list<Child> children);
+
+  static Node object(Children children = {});
+
+  Type type() const { return static_cast<Type>(value_.index()); }
+  bool isNull() const { return type() == Type::Null; }
+  bool isObject() const { return type() == Type::Object; }
+
+  bool boolValue() const;
+  std::int64_t intValue() const;
+  double doubleValue() const;
+  const std::string &stringValue() const;
+
+  // Children of an object in key order, none for other nodes
+  const Children &children() const;
+  std::size_t size() const { return children().size(); }
+  Children::const_iterator begin() const { return children().begin(); }
+  Children::const_iterator end() const { return children().end(); }
+
+  // Binary search, nullptr when the key is missing
+  const Node *child(const KeyType &key) const;
+
+  // Writes turn other nodes into objects and copy the children if they are
+  // shared with another node
+  void set(const KeyType &key, Node child);
+  bool erase(const KeyType &key);
+  // Calls `fn(Node &)` with the child at key, inserted as null if missing
+  template <class Fn>
+  void update(const KeyType &key, Fn &&fn);
+
+  // O(1): true if both nodes share their children or hold the same number or
+  // bool, strings are never identical
+  bool identical(const Node &other) const;
+  std::size_t hash() const;
+
+  bool operator==(const Node &other) const;
+  bool operator!=(const Node &other) const { return !(*this == other); }
+
+ private:
+  class Object;
+  using ObjectPtr = detail::IntrusivePtr<const Object>;
+
+  explicit Node(ObjectPtr object) : value_{std::move(object)} {}
+
+  const Object *objectPtr() const;
+  Object &ownObject();
+  static std::size_t childHash(const KeyType &key, const Node &child);
+
+  std::variant<std::monostate, bool, std::int64_t, double, std::string,
+               ObjectPtr>
+      value_;
+};
+
+class Node::Object {
+ public:
+  explicit Object(Children children = {}) : children_{std::move(children)} {
+    for (const auto &[key, child] : children_) {
+      hash_ += childHash(key, child);
+    }
+  }
+  Object(const Object &other)
+      : children_{other.children_}, hash_{other.hash_} {}
+
+  void addRef() const { refs_.increment(); }
+  void release() const {
+    if (refs_.decrement()) {
+      delete this;
+    }
+  }
+  long useCount() const { return refs_.get(); }
+
+  const Children &children() const { return children_; }
+  std::size_t hash() const { return hash_; }
+
+  Children::const_iterator find(const KeyType &key) const {
+    auto it = std::lower_bound(children_.begin(), children_.end(), key,
+                               keyLess);
+    return it != children_.end() && it->first == key ? it : children_.end();
+  }
+
+  template <class Fn>
+  void update(const KeyType &key, Fn &&fn) {
+    auto it = std::lower_bound(children_.begin(), children_.end(), key,
+                               keyLess);
+    if (it == children_.end() || it->first != key) {
+      it = children_.emplace(it, key, Node{});
+    } else {
+      hash_ -= childHash(key, it->second);
+    }
+    fn(it->second);
+    hash_ += childHash(key, it->second);
+  }
+
+  bool erase(const KeyType &key) {
+    auto it = find(key);
+    if (it == children_.end()) {
+      return false;
+    }
+    hash_ -= childHash(key, it->second);
+    children_.erase(it);
+    return true;
+  }
+
+ private:
+  static bool keyLess(const Child &child, const KeyType &key) {
+    return child.first < key;
+  }
+
+  Children children_;
+  // Sum of the child hashes, updated by each write in O(1)
+  std::size_t hash_ = static_cast<std::size_t>(Type::Object);
+  mutable detail::RefCount<true> refs_{0};
+};
+
+inline Node::Node(std::initializer_list<Child> children)
+    : Node{object(Children{children})} {}
+
+inline Node Node::object(Children children) {
+  std::stable_sort(
+      children.begin(), children.end(),
+      [](const Child &c1, const Child &c2) { return c1.first < c2.first; });
+  auto last = children.begin();
+  for (auto it = children.begin(); it != children.end(); ++it) {
+    if (last != children.begin() && std::prev(last)->first == it->first) {
+      *std::prev(last) = std::move(*it);
+    } else if (last++ != it) {
+      *std::prev(last) = std::move(*it);
+    }
+  }
+  children.erase(last, children.end());
+  return Node{ObjectPtr{new Object{std::move(children)}}};
+}
+
+inline bool Node::boolValue() const {
+  auto value = std::get_if<bool>(&value_);
+  return value && *value;
+}
+
+inline std::int64_t Node::intValue() const {
+  if (auto value = std::get_if<std::int64_t>(&value_)) {
+    return *value;
+  }
+  if (auto value = std::get_if<double>(&value_)) {
+    return static_cast<std::int64_t>(*value);
+  }
+  return 0;
+}
+
+inline double Node::doubleValue() const {
+  if (auto value = std::get_if<double>(&value_)) {
+    return *value;
+  }
+  if (auto value = std::get_if<std::int64_t>(&value_)) {
+    return static_cast<double>(*value);
+  }
+  return 0;
+}
+
+inline const std::string &Node::stringValue() const {
+  static const auto empty = std::string{};
+  auto value = std::get_if<std::string>(&value_);
+  return value ? *value : empty;
+}
+
+inline const Node::Children &Node::children() const {
+  static const auto none = Children{};
+  auto object = objectPtr();
+  return object ? object->children() : none;
+}
+
+inline const Node *Node::child(const KeyType &key) const {
+  if (auto object = objectPtr()) {
+    auto it = object->find(key);
+    return it != object->children().end() ? &it->second : nullptr;
+  }
+  return nullptr;
+}
+
+inline void Node::set(const KeyType &key, Node child) {
+  update(key, [&](Node &node) { node = std::move(child); });
+}
+
+inline bool Node::erase(const KeyType &key) {
+  return child(key) && ownObject().erase(key);
+}
+
+template <class Fn>
+void Node::update(const KeyType &key, Fn &&fn) {
+  ownObject().update(key, std::forward<Fn>(fn));
+}
+
+inline bool Node::identical(const Node &other) const {
+  if (value_.index() != other.value_.index()) {
+    return false;
+  }
+  switch (type()) {
+    case Type::Null:
+      return true;
+    case Type::Bool:
+      return std::get<bool>(value_) == std::get<bool>(other.value_);
+    case Type::Int:
+      return std::get<std::int64_t>(value_) ==
+             std::get<std::int64_t>(other.value_);
+    case Type::Double:
+      return std::get<double>(value_) == std::get<double>(other.value_);
+    case Type::String:
+      return false;
+    case Type::Object:
+      return objectPtr() == other.objectPtr();
+  }
+  return false;
+}
+
+inline std::size_t Node::hash() const {
+  switch (type()) {
+    case Type::Null:
+      return 0;
+    case Type::Bool:
+      return std::hash<bool>{}(std::get<bool>(value_)) ^ 0x10;
+    case Type::Int:
+      return std::hash<std::int64_t>{}(std::get<std::int64_t>(value_)) ^ 0x20;
+    case Type::Double:
+      return std::hash<double>{}(std::get<double>(value_)) ^ 0x30;
+    case Type::String:
+      return std::hash<std::string>{}(std::get<std::string>(value_)) ^ 0x40;
+    case Type::Object:
+      return objectPtr()->hash();
+  }
+  return 0;
+}
+
+inline bool Node::operator==(const Node &other) const {
+  if (value_.index() != other.value_.index()) {
+    return false;
+  }
+  if (!isObject()) {
+    return value_ == other.value_;
+  }
+  if (identical(other)) {
+    return true;
+  }
+  return hash() == other.hash() && children() == other.children();
+}
+
+inline const Node::Object *Node::objectPtr() const {
+  auto object = std::get_if<ObjectPtr>(&value_);
+  return object ? object->get() : nullptr;
+}
+
+// The children are only written through the last reference to them
+inline Node::Object &Node::ownObject() {
+  auto object = std::get_if<ObjectPtr>(&value_);
+  if (!object) {
+    object = &value_.emplace<ObjectPtr>(new Object{});
+  } else if (object->use_count() != 1) {
+    *object = ObjectPtr{new Object{**object}};
+  }
+  return const_cast<Object &>(**object);
+}
+
+inline std::size_t Node::childHash(const KeyType &key, const Node &child) {
+  auto hash = static_cast<std::uint64_t>(child.hash()) ^
+              (std::uint64_t{key.id()} * 0x9e3779b97f4a7c15ull);
+  hash = (hash ^ (hash >> 31)) * 0xbf58476d1ce4e5b9ull;
+  return static_cast<std::size_t>(hash ^ (hash >> 29));
+}
+
+// Trait of Node with interned paths, providing all the optional hooks but
+// locate: a node written in place would leave stale hashes in its ancestors
+struct NodeTrait {
+  using NodeType = Node;
+  using PathType = InternedPath;
+  using KeyType = InternedKey;
+  template <typename T, typename = void>
+  struct Impl;
+
+  static Node get(const Node &node, const PathType &path) {
+    auto child = &node;
+    for (const auto &key : path) {
+      if (!(child = child->child(key))) {
+        return {};
+      }
+    }
+    return *child;
+  }
+
+  static Node get(const Node &node, const KeyType &key) {
+    auto child = node.child(key);
+    return child ? *child : Node{};
+  }
+
+  static const Node *getChild(const Node &node, const KeyType &key) {
+    return node.child(key);
+  }
+
+  // Copies only the shared objects along the path, O(depth) of them
+  static void set(Node &node, const PathType &path, const Node &value) {
+    set(node, path.begin(), path.end(), Node{value});
+  }
+
+  static void set(Node &node, const PathType &path, Node &&value) {
+    set(node, path.begin(), path.end(), std::move(value));
+  }
+
+  static void erase(Node &node, const PathType &path) {
+    erase(node, path.begin(), path.end());
+  }
+
+  static bool isObject(const Node &node) { return node.isObject(); }
+  static bool equal(const Node &node1, const Node &node2) {
+    return node1 == node2;
+  }
+  static bool identical(const Node &node1, const Node &node2) {
+    return node1.identical(node2);
+  }
+  static std::size_t hash(const Node &node) { return node.hash(); }
+  static bool empty(const Node &node) { return node.isNull(); }
+
+  static constexpr bool sortedChildren = true;
+
+  template <class Fn>
+  static void forEachChild(const Node &node, Fn &&fn) {
+    for (const auto &[key, child] : node) {
+      fn(key, child);
+    }
+  }
+
+  static std::size_t size(const Node &node) { return node.size(); }
+
+  template <typename T>
+  static T get(const Node &node, const PathType &path) {
+    return Impl<T>::get(get(node, path));
+  }
+
+  template <class Int>
+  struct Impl<Int, std::enable_if_t<std::is_integral_v<Int> &&
+                                    !std::is_same_v<Int, bool>>> {
+    static Int get(const Node &node) {
+      return static_cast<Int>(node.intValue());
+    }
+  };
+
+  template <class Bool>
+  struct Impl<Bool, std::enable_if_t<std::is_same_v<Bool, bool>>> {
+    static bool get(const Node &node) { return node.boolValue(); }
+  };
+
+  template <class Float>
+  struct Impl<Float, std::enable_if_t<std::is_floating_point_v<Float>>> {
+    static Float get(const Node &node) {
+      return static_cast<Float>(node.doubleValue());
+    }
+  };
+
+  template <class String>
+  struct Impl<String, std::enable_if_t<std::is_same_v<String, std::string>>> {
+    static const std::string &get(const Node &node) {
+      return node.stringValue();
+    }
+  };
+
+  template <class Self>
+  struct Impl<Self, std::enable_if_t<std::is_same_v<Self, Node>>> {
+    static const Node &get(const Node &node) { return node; }
+  };
+
+ private:
+  using KeyIt = PathType::const_iterator;
+
+  static void set(Node &node, KeyIt first, KeyIt last, Node &&value) {
+    if (first == last) {
+      node = std::move(value);
+    } else {
+      node.update(*first, [&](Node &child) {
+        set(child, std::next(first), last, std::move(value));
+      });
+    }
+  }
+
+  static void erase(Node &node, KeyIt first, KeyIt last) {
+    if (first == last) {
+      node = Node{};
+    } else if (std::next(first) == last) {
+      node.erase(*first);
+    } else if (node.child(*first)) {
+      node.update(*first, [&](Node &child) {
+        erase(child, std::next(first), last);
+      });
+    }
+  }
+};
+
+}  // namespace otree
+
+namespace std {
+
+template <>
+struct hash<otree::Node> {
+  size_t operator()(const otree::Node &node) const { return node.hash(); }
+};
+
+}  // namespace std
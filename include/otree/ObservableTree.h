@@ -1,11 +1,27 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <iterator>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace otree {
@@ -23,6 +39,233 @@ struct LockGuard {
   ~LockGuard() { m_.unlock(); }
 };
 
+// Instrumentation policy that compiles to nothing. A policy is a member of the
+// tree whose hooks are called under the tree lock: onSet() per update,
+// onDiff() per subscription level diffed, onCompare() per observed node
+// compared, onEquality() per Trait::equal call, onNotify() per notification
+// and onLocked(duration) with the time an update held the lock. Its nested
+// SignalState is a member of each signal: onFire() per notification
+// dispatched to connected slots, onSlot(duration) after each slot, called on
+// the thread running the slots. Durations are measured only if Timed is true.
+// Tasks of a parallel diff count into policies of their own, added to the
+// tree's one by merge(other) if the policy has it.
+struct NoInstrumentation {
+  using Clock = std::chrono::steady_clock;
+  static constexpr bool Timed = false;
+
+  struct SignalState {
+    void onFire() {}
+    void onSlot(Clock::duration) {}
+  };
+
+  void onSet() {}
+  void onDiff() {}
+  void onCompare() {}
+  void onEquality() {}
+  void onNotify() {}
+  void onLocked(Clock::duration) {}
+  void merge(const NoInstrumentation &) {}
+};
+
+struct TreeStats {
+  std::uint64_t sets = 0;
+  std::uint64_t diffs = 0;
+  std::uint64_t nodesCompared = 0;
+  std::uint64_t equalCalls = 0;
+  std::uint64_t notifications = 0;
+  std::chrono::steady_clock::duration lockHeld{};
+};
+
+struct SignalStats {
+  std::uint64_t fires = 0;
+  std::chrono::steady_clock::duration slotTime{};
+  std::chrono::steady_clock::duration slowestSlot{};
+};
+
+// Instrumentation policy counting into TreeStats, returned by tree.stats(),
+// and SignalStats, returned by signal->stats(). Exporters can derive from it
+// and shadow hooks, calling the base ones.
+class CountingInstrumentation {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr bool Timed = true;
+
+  class SignalState {
+   public:
+    void onFire() { fires_.fetch_add(1, std::memory_order_relaxed); }
+    void onSlot(Clock::duration elapsed) {
+      auto ticks = elapsed.count();
+      slotTime_.fetch_add(ticks, std::memory_order_relaxed);
+      auto slowest = slowestSlot_.load(std::memory_order_relaxed);
+      while (slowest < ticks &&
+             !slowestSlot_.compare_exchange_weak(slowest, ticks,
+                                                 std::memory_order_relaxed)) {
+      }
+    }
+
+    SignalStats stats() const {
+      return {fires_.load(std::memory_order_relaxed),
+              Clock::duration{slotTime_.load(std::memory_order_relaxed)},
+              Clock::duration{slowestSlot_.load(std::memory_order_relaxed)}};
+    }
+
+   private:
+    std::atomic<std::uint64_t> fires_{0};
+    std::atomic<Clock::rep> slotTime_{0};
+    std::atomic<Clock::rep> slowestSlot_{0};
+  };
+
+  void onSet() { ++stats_.sets; }
+  void onDiff() { ++stats_.diffs; }
+  void onCompare() { ++stats_.nodesCompared; }
+  void onEquality() { ++stats_.equalCalls; }
+  void onNotify() { ++stats_.notifications; }
+  void onLocked(Clock::duration held) { stats_.lockHeld += held; }
+
+  void merge(const CountingInstrumentation &other) {
+    stats_.diffs += other.stats_.diffs;
+    stats_.nodesCompared += other.stats_.nodesCompared;
+    stats_.equalCalls += other.stats_.equalCalls;
+    stats_.notifications += other.stats_.notifications;
+  }
+
+  const TreeStats &stats() const { return stats_; }
+
+ private:
+  TreeStats stats_;
+};
+
+namespace detail {
+
+// Calls `fn(first, last)` for each non empty key of a separated path string,
+// stops and returns false as soon as `fn` returns false
+template <class String, class Fn>
+bool forEachKey(const String &path, char sep, Fn &&fn) {
+  using std::begin;
+  using std::end;
+  auto istart = begin(path);
+  auto iend = end(path);
+  if (istart != iend && *std::prev(iend) == '\0') {
+    --iend;
+  }
+  for (auto it = istart; it != iend; ++it) {
+    if (*it == sep) {
+      if (istart != it && !fn(istart, it)) {
+        return false;
+      }
+      istart = std::next(it);
+    }
+  }
+  return istart == iend || fn(istart, iend);
+}
+
+}  // namespace detail
+
+// Path literal split at compile time into views of its keys, each with its
+// FNV-1a hash, N being the size of the literal
+//
+//   constexpr auto usbEnabled = otree::StaticPath{"config/usb/enabled"};
+template <std::size_t N>
+class StaticPath {
+ public:
+  using KeyType = std::string_view;
+  using iterator = const KeyType *;
+  using const_iterator = const KeyType *;
+
+  constexpr StaticPath(const char (&path)[N], char sep = '/') {
+    auto length = std::char_traits<char>::length(path);
+    std::size_t first = 0;
+    for (std::size_t i = 0; i <= length; ++i) {
+      if (i == length || path[i] == sep) {
+        if (i != first) {
+          keys_[size_] = KeyType{path + first, i - first};
+          hashes_[size_] = hashKey(keys_[size_]);
+          hash_ = (hash_ ^ hashes_[size_]) * Prime;
+          ++size_;
+        }
+        first = i + 1;
+      }
+    }
+  }
+
+  constexpr std::size_t size() const { return size_; }
+  constexpr const KeyType &key(std::size_t i) const { return keys_[i]; }
+  constexpr std::uint64_t keyHash(std::size_t i) const { return hashes_[i]; }
+  constexpr std::uint64_t hash() const { return hash_; }
+
+  constexpr const_iterator begin() const { return keys_.data(); }
+  constexpr const_iterator end() const { return keys_.data() + size_; }
+
+  std::string toString(char sep = '/') const {
+    auto str = std::string{};
+    for (auto key : *this) {
+      str.append(key).push_back(sep);
+    }
+    if (!str.empty()) {
+      str.pop_back();
+    }
+    return str;
+  }
+
+  template <std::size_t M>
+  constexpr bool operator==(const StaticPath<M> &other) const {
+    if (hash_ != other.hash() || size_ != other.size()) {
+      return false;
+    }
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (keys_[i] != other.key(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  static constexpr std::uint64_t Prime = 0x100000001b3ull;
+
+  static constexpr std::uint64_t hashKey(KeyType key) {
+    auto hash = std::uint64_t{0xcbf29ce484222325ull};
+    for (auto c : key) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * Prime;
+    }
+    return hash;
+  }
+
+  std::array<KeyType, (N + 1) / 2> keys_{};
+  std::array<std::uint64_t, (N + 1) / 2> hashes_{};
+  std::size_t size_ = 0;
+  std::uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+namespace detail {
+
+// Static path converted once to each path type it is passed as
+template <class Literal>
+class StaticPathSite {
+ public:
+  explicit StaticPathSite(Literal literal) : literal_{literal} {}
+
+  template <class PathType>
+  operator const PathType &() const {
+    static const PathType path(literal_());
+    return path;
+  }
+
+ private:
+  Literal literal_;
+};
+
+}  // namespace detail
+
+// Path literal that is neither parsed nor allocated at runtime once the call
+// site ran, e.g. tree.set(OTREE_PATH("config/usb/enabled"), node). The path
+// type must be constructible from StaticPath.
+#define OTREE_PATH(literal)                                  \
+  (::otree::detail::StaticPathSite{[] {                      \
+    constexpr auto staticPath = ::otree::StaticPath{literal}; \
+    return staticPath;                                       \
+  }})
+
 class Path {
  public:
   using KeyType = std::string;
@@ -40,6 +283,14 @@ class Path {
   Path(Keys &&ks) : keys_{std::move(ks)} {}
   Path(const Keys &ks) : keys_{ks} {}
 
+  template <std::size_t N>
+  Path(const StaticPath<N> &path) {
+    keys_.reserve(path.size());
+    for (auto key : path) {
+      keys_.emplace_back(key);
+    }
+  }
+
   template <class String>
   Path(const String &path, Sep sep = '/') : keys_{toKeys(path, sep)} {}
   const Keys &keys() const { return keys_; }
@@ -76,23 +327,21 @@ class Path {
 
   template <class String>
   bool operator==(const String &p) const {
-    auto ks = toKeys(p);
-    if (ks.size() != keys_.size()) {
-      return false;
-    } else {
-      auto mi = keys_.rbegin();
-      auto i = ks.rbegin();
-      auto miend = keys_.rend();
-      auto iend = ks.rend();
-      while (mi != miend && i != iend) {
-        if (*mi != *i) {
-          return false;
-        }
-        ++mi;
-        ++i;
+    auto it = keys_.begin();
+    auto matches = detail::forEachKey(p, '/', [&](auto first, auto last) {
+      if (it == keys_.end() ||
+          !std::equal(first, last, it->begin(), it->end())) {
+        return false;
       }
+      ++it;
       return true;
-    }
+    });
+    return matches && it == keys_.end();
+  }
+
+  template <std::size_t N>
+  bool operator==(const StaticPath<N> &path) const {
+    return std::equal(keys_.begin(), keys_.end(), path.begin(), path.end());
   }
 
   auto begin() { return keys_.begin(); }
@@ -107,326 +356,2661 @@ class Path {
  private:
   template <class String>
   static Keys toKeys(const String &path, Sep sep = '/') {
-    using std::begin;
-    using std::end;
     auto keys = Keys{};
-
-    auto istart = begin(path);
-    auto iend = end(path);
-    auto it = istart;
-
-    while (it != iend) {
-      if (*it == sep) {
-        if (*istart != sep) {
-          keys.emplace_back(istart, it);
-        }
-        istart = ++it;
-      } else {
-        ++it;
-      }
-    }
-    if (istart != iend) {
-      auto last = KeyType{istart, iend};
-      if (last.back() == '\0') {
-        last.resize(last.size() - 1);
-      }
-      if (!last.empty()) {
-        keys.emplace_back(std::move(last));
-      }
-    }
+    detail::forEachKey(path, sep, [&keys](auto first, auto last) {
+      keys.emplace_back(first, last);
+      return true;
+    });
     return keys;
   }
 
   Keys keys_;
 };
 
-bool operator<(const Path &kp1, const Path &kp2) {
+inline bool operator<(const Path &kp1, const Path &kp2) {
   return kp1.keys() < kp2.keys();
 }
 
-bool operator==(const Path &kp1, const Path &kp2) {
+inline bool operator==(const Path &kp1, const Path &kp2) {
   return kp1.keys() == kp2.keys();
 }
 
-template <class Tree>
-class ModificationSignal
-    : public std::enable_shared_from_this<ModificationSignal<Tree>> {
-  using NodeType = typename Tree::NodeType;
-  using SlotType = std::function<void(const NodeType &, const NodeType &)>;
-  using SlotIDType = SlotType *;
-  using SlotListType = std::list<std::unique_ptr<SlotType>>;
-  using MutexType = typename Tree::MutexType;
-
-  static constexpr SlotIDType SlotIDInvalid = nullptr;
+namespace detail {
+
+template <class Trait, class Node, class Key, class = void>
+struct HasGetChild : std::false_type {};
+
+// Optional trait hook: `static const Node *getChild(const Node &, const Key &)`
+// gives borrowed access to a direct child, nullptr when the key is missing
+template <class Trait, class Node, class Key>
+struct HasGetChild<Trait, Node, Key,
+                   std::void_t<decltype(Trait::getChild(
+                       std::declval<const Node &>(),
+                       std::declval<const Key &>()))>> : std::true_type {};
+
+template <class Trait, class Node, class = void>
+struct HasIdentical : std::false_type {};
+
+// Optional trait hook: `static bool identical(const Node &, const Node &)`
+// must be O(1) and return true only if both nodes share the same payload, the
+// whole subtree is then skipped without comparing or visiting observers
+template <class Trait, class Node>
+struct HasIdentical<Trait, Node,
+                    std::void_t<decltype(Trait::identical(
+                        std::declval<const Node &>(),
+                        std::declval<const Node &>()))>> : std::true_type {};
+
+template <class Trait, class Node>
+bool identical(const Node &node1, const Node &node2) {
+  if constexpr (HasIdentical<Trait, Node>::value) {
+    return Trait::identical(node1, node2);
+  } else {
+    return &node1 == &node2;
+  }
+}
 
-  class Connection {
-   public:
-    using SignalType = ModificationSignal<Tree>;
-    using SignalRefType = std::weak_ptr<SignalType>;
-    using SlotIDType = SignalType::SlotIDType;
+template <class Trait, class Node, class = void>
+struct HasHash : std::false_type {};
+
+// Optional trait hook: `static size_t hash(const Node &)` returns a structural
+// hash of the subtree, equal for equal subtrees. It must be O(1), e.g. cached
+// in the node. Nodes with different hashes are changed without calling
+// Trait::equal, which then only confirms matching hashes. NodeTrait provides
+// it from the hash kept by Node.
+template <class Trait, class Node>
+struct HasHash<
+    Trait, Node,
+    std::void_t<decltype(Trait::hash(std::declval<const Node &>()))>>
+    : std::true_type {};
+
+template <class Trait, class Node, class Path, class = void>
+struct HasLocate : std::false_type {};
+
+// Optional trait hook: `static Node *locate(Node &root, const Path &)` returns
+// the node at path or nullptr. The node must stay at that address until the
+// root is modified other than by assigning to the located node.
+template <class Trait, class Node, class Path>
+struct HasLocate<Trait, Node, Path,
+                 std::void_t<decltype(Trait::locate(
+                     std::declval<Node &>(), std::declval<const Path &>()))>>
+    : std::true_type {};
+
+template <class Trait, class Node, class Key, class = void>
+struct HasForEachChild : std::false_type {};
+
+// Optional trait hook: `static void forEachChild(const Node &, Fn &&fn)` calls
+// `fn(const Key &, const Node &)` for each direct child. Together with
+// getChild it enables the wildcard keys "*", one key, and "**", one or more
+// keys, in subscription paths.
+template <class Trait, class Node, class Key>
+struct HasForEachChild<
+    Trait, Node, Key,
+    std::void_t<decltype(Trait::forEachChild(
+        std::declval<const Node &>(),
+        std::declval<void (*)(const Key &, const Node &)>()))>>
+    : std::true_type {};
+
+template <class Trait, class Key, class = void>
+struct HasMakePath : std::false_type {};
+
+// Optional trait hook: `static Path makePath(const std::vector<Key> &)` for
+// path types that cannot be constructed from their keys
+template <class Trait, class Key>
+struct HasMakePath<Trait, Key,
+                   std::void_t<decltype(Trait::makePath(
+                       std::declval<const std::vector<Key> &>()))>>
+    : std::true_type {};
+
+template <class Trait, class Node, class = void>
+struct HasSize : std::false_type {};
+
+// Optional trait hook: `static size_t size(const Node &)` returns the number
+// of direct children in O(1), it lets a diff walk the children instead of the
+// observed keys when there are fewer of them
+template <class Trait, class Node>
+struct HasSize<Trait, Node,
+               std::void_t<decltype(Trait::size(std::declval<const Node &>()))>>
+    : std::true_type {};
+
+template <class Trait, class = void>
+struct HasSortedChildren : std::false_type {};
+
+// Optional trait flag: `static constexpr bool sortedChildren = true` if
+// forEachChild visits the children in ascending key order, a diff can then
+// merge the children with the observed keys
+template <class Trait>
+struct HasSortedChildren<Trait, std::void_t<decltype(Trait::sortedChildren)>>
+    : std::true_type {};
+
+template <class Trait>
+constexpr bool sortedChildren() {
+  if constexpr (HasSortedChildren<Trait>::value) {
+    return Trait::sortedChildren;
+  } else {
+    return false;
+  }
+}
 
-    void disconnect() {
-      if (slotID_) {
-        if (auto sig = signalRef_.lock()) {
-          sig->disconnect(slotID_);
-        }
-      }
-    }
+template <class Trait, class Node, class Path, class = void>
+struct HasErase : std::false_type {};
+
+// Optional trait hook: `static void erase(Node &root, const Path &)` removes
+// the node at path if there is one, merge patches need it to delete
+template <class Trait, class Node, class Path>
+struct HasErase<Trait, Node, Path,
+                std::void_t<decltype(Trait::erase(
+                    std::declval<Node &>(), std::declval<const Path &>()))>>
+    : std::true_type {};
+
+template <class Trait, class Node, class = void>
+struct HasIsObject : std::false_type {};
+
+// Optional trait hook: `static bool isObject(const Node &)` tells the nodes a
+// merge patch merges into, e.g. json objects, from the ones it replaces. By
+// default only nodes with children are merged into.
+template <class Trait, class Node>
+struct HasIsObject<
+    Trait, Node,
+    std::void_t<decltype(Trait::isObject(std::declval<const Node &>()))>>
+    : std::true_type {};
+
+template <class Trait, class Node, class Key>
+bool isObject(const Node &node) {
+  if constexpr (HasIsObject<Trait, Node>::value) {
+    return Trait::isObject(node);
+  } else if constexpr (HasSize<Trait, Node>::value) {
+    return Trait::size(node) != 0;
+  } else {
+    auto children = false;
+    Trait::forEachChild(node,
+                        [&](const Key &, const Node &) { children = true; });
+    return children;
+  }
+}
 
-    bool connected() const { return slotID_ != SlotIDInvalid; }
+template <class Trait, class Path, class Key>
+Path makePath(const std::vector<const Key *> &keys) {
+  auto list = std::vector<Key>{};
+  list.reserve(keys.size());
+  for (auto key : keys) {
+    list.push_back(*key);
+  }
+  if constexpr (HasMakePath<Trait, Key>::value) {
+    return Trait::makePath(list);
+  } else {
+    return Path{std::move(list)};
+  }
+}
 
-    Connection(Connection &&other)
-        : signalRef_{std::move(other.signalRef_)}, slotID_{other.slotID_} {
-      other.slotID_ = SlotIDInvalid;
-    }
+template <class Trait, class Path, class Key>
+constexpr bool canMakePath() {
+  return HasMakePath<Trait, Key>::value ||
+         std::is_constructible_v<Path, std::vector<Key>>;
+}
 
-    Connection &operator=(Connection &&other) {
-      signalRef_ = std::move(other.signalRef_);
-      slotID_ = other.slotID_;
-      other.slotID_ = SlotIDInvalid;
-    }
+template <class Trait, class T, class Node, class = void>
+struct HasImpl : std::false_type {};
+
+// Optional trait hook: `Trait::Impl<T>::get(const Node &)` converts a node to
+// a value of type T, otherwise `Trait::get<T>` is called with the empty path
+template <class Trait, class T, class Node>
+struct HasImpl<Trait, T, Node,
+               std::void_t<decltype(Trait::template Impl<T>::get(
+                   std::declval<const Node &>()))>> : std::true_type {};
+
+template <class Trait, class T, class Node, class Path>
+T convert(const Node &node) {
+  if constexpr (HasImpl<Trait, T, Node>::value) {
+    return Trait::template Impl<T>::get(node);
+  } else {
+    return Trait::template get<T>(node, Path{});
+  }
+}
 
-    Connection(const Connection &) = delete;
-    Connection &operator=(const Connection &) = delete;
+template <class T, class = void>
+struct IsEqualityComparable : std::false_type {};
 
-   private:
-    friend class ModificationSignal;
-    Connection() = default;
-    Connection(SignalRefType &&sigref, SlotIDType slotID)
-        : signalRef_{std::move(sigref)}, slotID_{slotID} {}
+template <class T>
+struct IsEqualityComparable<T, std::void_t<decltype(std::declval<const T &>() ==
+                                                    std::declval<const T &>())>>
+    : std::true_type {};
 
-    SignalRefType signalRef_;
-    SlotIDType slotID_ = SlotIDInvalid;
-  };
+enum class Wildcard : char { None, Child, Subtree };
 
-  enum class ImplType : char { Single, Multi };
+template <class Key>
+const Key &wildcardKey(Wildcard kind) {
+  static const Key child{"*"};
+  static const Key subtree{"**"};
+  return kind == Wildcard::Child ? child : subtree;
+}
 
-  class ImplIF {
-   public:
-    virtual ~ImplIF() = default;
-    virtual SlotIDType connect(SlotType &&sl) = 0;
-    virtual void disconnect(SlotIDType slID) = 0;
-    virtual void onChanged(const NodeType &oldNode,
-                           const NodeType &newNode) = 0;
-    virtual SlotListType stealSlots() = 0;
-    virtual bool connected() const = 0;
-    virtual ImplType type() = 0;
-  };
+template <class Key>
+Wildcard wildcard(const Key &key) {
+  if constexpr (std::is_constructible_v<Key, const char *>) {
+    if (key == wildcardKey<Key>(Wildcard::Child)) {
+      return Wildcard::Child;
+    }
+    if (key == wildcardKey<Key>(Wildcard::Subtree)) {
+      return Wildcard::Subtree;
+    }
+  }
+  return Wildcard::None;
+}
 
-  class SingleImpl : public ImplIF {
-    std::unique_ptr<SlotType> slot_ = nullptr;
+// Sorted vector map: lookups are binary searches and the entries of a level
+// are iterated in contiguous memory
+template <class Key, class Value>
+class FlatMap {
+ public:
+  using value_type = std::pair<Key, Value>;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  iterator begin() { return items_.begin(); }
+  iterator end() { return items_.end(); }
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+  size_t size() const { return items_.size(); }
+  bool empty() const { return items_.empty(); }
+
+  iterator find(const Key &key) {
+    auto it = lowerBound(key);
+    return it != items_.end() && !(key < it->first) ? it : items_.end();
+  }
 
-   public:
-    ~SingleImpl() = default;
-    ImplType type() override { return ImplType::Single; }
-    bool connected() const override { return !!slot_; }
-    SlotIDType connect(SlotType &&sl) override {
-      slot_ = std::make_unique<SlotType>(std::move(sl));
-      return slot_.get();
+  Value &operator[](const Key &key) {
+    auto it = lowerBound(key);
+    if (it == items_.end() || key < it->first) {
+      it = items_.emplace(it, key, Value{});
     }
+    return it->second;
+  }
 
-    void disconnect(SlotIDType slotID) override {
-      if (slot_.get() == slotID) {
-        slot_.reset();
-      }
-    }
+  iterator erase(iterator it) { return items_.erase(it); }
 
-    SlotListType stealSlots() override {
-      auto sls = SlotListType{};
-      sls.push_back(std::move(slot_));
-      return sls;
-    }
+ private:
+  iterator lowerBound(const Key &key) {
+    return std::lower_bound(
+        items_.begin(), items_.end(), key,
+        [](const value_type &item, const Key &k) { return item.first < k; });
+  }
 
-    void onChanged(const NodeType &oldNode, const NodeType &newNode) override {
-      if (slot_ && *slot_) {
-        (*slot_)(oldNode, newNode);
-      }
+  std::vector<value_type> items_;
+};
+
+// Objects of type T carved from chunks of `ChunkSize` of them and reused
+// through a free list, so that objects created together stay close in memory.
+// Parallel diffs may destroy objects from several threads.
+template <class T, size_t ChunkSize = 64>
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  template <class... Args>
+  T *create(Args &&...args) {
+    auto block = acquire();
+    try {
+      return new (block->storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+      recycle(block);
+      throw;
     }
-  };
+  }
 
-  class MultiImpl : public ImplIF {
-    SlotListType slots_;
+  void destroy(T *object) {
+    object->~T();
+    recycle(reinterpret_cast<Block *>(object));
+  }
 
-   public:
-    MultiImpl() = default;
-    MultiImpl(SlotListType &&list) : slots_{std::move(list)} {}
-    ImplType type() override { return ImplType::Multi; }
-    bool connected() const override { return !slots_.empty(); }
-    SlotIDType connect(SlotType &&sl) override {
-      if (sl) {
-        auto slotID = new SlotType{std::move(sl)};
-        slots_.emplace_back(slotID);
-        return slotID;
+ private:
+  union Block {
+    Block *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  Block *acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_) {
+      auto &chunk = chunks_.emplace_back(std::make_unique<Block[]>(ChunkSize));
+      for (size_t i = ChunkSize; i-- > 0;) {
+        chunk[i].next = std::exchange(free_, &chunk[i]);
       }
-      return SlotIDInvalid;
     }
+    return std::exchange(free_, free_->next);
+  }
 
-    void disconnect(SlotIDType slotID) override {
-      slots_.erase(std::find_if(
-          slots_.begin(), slots_.end(),
-          [slotID](const auto &sl) { return sl.get() == slotID; }));
-    }
+  void recycle(Block *block) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->next = std::exchange(free_, block);
+  }
 
-    void onChanged(const NodeType &oldNode, const NodeType &newNode) override {
-      for (auto &sl : slots_) {
-        (*sl)(oldNode, newNode);
-      }
-    }
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Block[]>> chunks_;
+  Block *free_ = nullptr;
+};
+
+// Stores of the levels of a subscription index, one per tree. Levels are
+// created with the store, which they pass on to the levels below them.
+template <class Level>
+class HeapLevels {
+ public:
+  using Ptr = std::unique_ptr<Level>;
+
+  Ptr create() { return std::make_unique<Level>(*this); }
+};
 
-    SlotListType stealSlots() override { return std::move(slots_); }
+template <class Level>
+class ArenaLevels {
+  struct Deleter {
+    ArenaLevels *levels = nullptr;
+    void operator()(Level *level) const { levels->arena_.destroy(level); }
   };
 
  public:
-  Connection connect(SlotType sl) {
-    SlotIDType slotID = SlotIDInvalid;
-    if (sl) {
-      LockGuard lock(mutex_);
-      if (!impl_) {
-        impl_ = std::make_unique<SingleImpl>();
-      } else if ((impl_->type() == ImplType::Single) && impl_->connected()) {
-        impl_.reset(new MultiImpl{impl_->stealSlots()});
-      }
-      slotID = impl_->connect(std::move(sl));
-    }
-    if (slotID != SlotIDInvalid) {
-      return Connection{weak_from_this(), slotID};
-    }
-    return {};
-  }
+  using Ptr = std::unique_ptr<Level, Deleter>;
+
+  Ptr create() { return Ptr{arena_.create(*this), Deleter{this}}; }
 
  private:
-  template <class TreeClass>
-  friend class SignalMgr;
+  Arena<Level> arena_;
+};
 
-  bool connected() const {
-    LockGuard lock(mutex_);
-    return impl_ && impl_->connected();
+// Optional index policy hook: `template <class Level> using Levels`, the store
+// of the levels, HeapLevels by default
+template <class Index, class Level, class = void>
+struct LevelsOf {
+  using Type = HeapLevels<Level>;
+};
+
+template <class Index, class Level>
+struct LevelsOf<Index, Level,
+                std::void_t<typename Index::template Levels<Level>>> {
+  using Type = typename Index::template Levels<Level>;
+};
+
+template <class Node>
+const Node &emptyNode() {
+  static const Node empty{};
+  return empty;
+}
+
+// Child of a node, borrowed if the trait supports it, otherwise a copy made by
+// `Trait::get(node, key)`
+template <class Trait, class Node, class Key>
+class ChildRef {
+  static constexpr bool Borrowed = HasGetChild<Trait, Node, Key>::value;
+  using StorageType = std::conditional_t<Borrowed, const Node *, Node>;
+
+ public:
+  ChildRef(const Node &parent, const Key &key)
+      : storage_{lookup(parent, key)} {}
+
+  const Node &operator*() const {
+    if constexpr (Borrowed) {
+      return *storage_;
+    } else {
+      return storage_;
+    }
   }
 
-  void disconnect(SlotIDType slotID) {
-    LockGuard lock(mutex_);
-    if (impl_) {
-      impl_->disconnect(slotID);
+ private:
+  static StorageType lookup(const Node &parent, const Key &key) {
+    if constexpr (Borrowed) {
+      if (auto child = Trait::getChild(parent, key)) {
+        return child;
+      }
+      return &emptyNode<Node>();
+    } else {
+      return Trait::get(parent, key);
     }
   }
 
-  void operator()(const NodeType &jOld, const NodeType &jNew) {
-    LockGuard lock(mutex_);
-    if (impl_) {
-      impl_->onChanged(jOld, jNew);
+  StorageType storage_;
+};
+
+// Node at `path` borrowed through getChild, the empty node if it is missing
+template <class Trait, class Node, class Key, class Path>
+const Node &nodeAt(const Node &root, const Path &path) {
+  using std::begin;
+  using std::end;
+  const Node *node = &root;
+  for (auto it = begin(path), last = end(path); it != last; ++it) {
+    if (node = Trait::getChild(*node, *it); !node) {
+      return emptyNode<Node>();
     }
   }
+  return *node;
+}
+
+// Holds a value that takes no space when its type is empty
+template <class T, bool = std::is_empty_v<T> && !std::is_final_v<T>>
+class Compressed {
+ public:
+  T &get() const { return value_; }
 
-  // TBD: Should be compressed pair for case of NoEffectMutex to reduce memory
-  // usage
-  std::unique_ptr<ImplIF> impl_;
-  mutable MutexType mutex_;
+ private:
+  mutable T value_;
 };
 
-template <class Tree>
-class SignalMgr {
+template <class T>
+class Compressed<T, true> : private T {
  public:
-  using SignalType = ModificationSignal<Tree>;
-  using PathType = typename Tree::PathType;
-  using KeyType = typename Tree::KeyType;
-  using TraitType = typename Tree::TraitType;
-  using NodeType = typename Tree::NodeType;
-  using SignalPtrType = std::shared_ptr<SignalType>;
+  T &get() const { return const_cast<Compressed &>(*this); }
+};
 
-  SignalPtrType createSignal(const PathType &path) {
-    using namespace std;
-    //    using std::begin;
-    //    using std::end;
-    auto ibeg = begin(path);
-    auto iend = end(path);
-    if (ibeg != iend) {
-      return createSignal(ibeg, iend);
+// Reference count, atomic only if it is shared between threads
+template <bool Atomic>
+class RefCount {
+ public:
+  explicit RefCount(std::uint32_t count) : count_{count} {}
+  void increment() { ++count_; }
+  // true if the count dropped to zero
+  bool decrement() { return --count_ == 0; }
+  bool incrementIfNotZero() { return count_ && ++count_; }
+  std::uint32_t get() const { return count_; }
+
+ private:
+  std::uint32_t count_;
+};
+
+template <>
+class RefCount<true> {
+ public:
+  explicit RefCount(std::uint32_t count) : count_{count} {}
+  void increment() { count_.fetch_add(1, std::memory_order_relaxed); }
+  bool decrement() {
+    return count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  bool incrementIfNotZero() {
+    auto count = count_.load(std::memory_order_relaxed);
+    while (count && !count_.compare_exchange_weak(count, count + 1,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed)) {
     }
-    return {};
+    return count != 0;
   }
+  std::uint32_t get() const { return count_.load(std::memory_order_acquire); }
 
-  bool onChanged(const NodeType &oldNode, const NodeType &newNode) {
-    bool hasChanged = false;
-    if (!TraitType::empty(oldNode) || !TraitType::empty(newNode)) {
-      for (auto &[key, subAndObservers] : signalsMap_) {
-        auto oldValue = TraitType::get(oldNode, key);
-        auto newValue = TraitType::get(newNode, key);
-        auto &[modSignal, sub] = subAndObservers;
-        if (sub) {
-          if (sub->onChanged(oldValue, newValue)) {
-            hasChanged = true;
-            if (modSignal) {
-              (*modSignal)(oldValue, newValue);
-            };
-            // if sub value changed then current one must be changed
-            // don't need to waste time comparing
-            continue;
-          }
-        }
-
-        auto diff = !TraitType::equal(oldValue, newValue);
-        hasChanged |= diff;
+ private:
+  std::atomic<std::uint32_t> count_;
+};
 
-        if (modSignal) {
-          if (modSignal->connected()) {
-            if (diff) {
-              (*modSignal)(oldValue, newValue);
-            }
-          } else {
-            modSignal.reset();
-          }
-        }
-      }
+// Owning pointer to an object that counts its references itself through
+// addRef(), release() and useCount()
+template <class T>
+class IntrusivePtr {
+ public:
+  IntrusivePtr() = default;
+  IntrusivePtr(std::nullptr_t) {}
+  explicit IntrusivePtr(T *ptr) : ptr_{ptr} {
+    if (ptr_) {
+      ptr_->addRef();
     }
-    return hasChanged;
   }
+  IntrusivePtr(const IntrusivePtr &other) : IntrusivePtr{other.ptr_} {}
+  IntrusivePtr(IntrusivePtr &&other) noexcept : ptr_{other.ptr_} {
+    other.ptr_ = nullptr;
+  }
+  ~IntrusivePtr() { reset(); }
 
-  bool onChanged(const PathType &path, const NodeType &oldData,
-                 const NodeType &newData) {
-    if (auto signalPtr = getSignal(path)) {
-      if (!TraitType::equal(oldData, newData)) {
-        (*signalPtr)(oldData, newData);
-        return true;
-      }
-    }
-    return false;
+  IntrusivePtr &operator=(IntrusivePtr other) noexcept {
+    std::swap(ptr_, other.ptr_);
+    return *this;
+  }
+
+  void reset() {
+    if (auto ptr = std::exchange(ptr_, nullptr)) {
+      ptr->release();
+    }
+  }
+
+  T *get() const { return ptr_; }
+  T &operator*() const { return *ptr_; }
+  T *operator->() const { return ptr_; }
+  explicit operator bool() const { return ptr_ != nullptr; }
+  long use_count() const { return ptr_ ? ptr_->useCount() : 0; }
+
+  bool operator==(const IntrusivePtr &other) const {
+    return ptr_ == other.ptr_;
+  }
+  bool operator!=(const IntrusivePtr &other) const {
+    return ptr_ != other.ptr_;
+  }
+
+ private:
+  template <class U>
+  friend class WeakPtr;
+  struct Adopt {};
+  IntrusivePtr(T *ptr, Adopt) : ptr_{ptr} {}
+
+  T *ptr_ = nullptr;
+};
+
+// Non owning counterpart of IntrusivePtr, the object releases its resources
+// with the last IntrusivePtr and its memory with the last WeakPtr. T counts
+// weak references through addWeakRef(), releaseWeakRef() and tryAddRef().
+template <class T>
+class WeakPtr {
+ public:
+  WeakPtr() = default;
+  explicit WeakPtr(T *ptr) : ptr_{ptr} {
+    if (ptr_) {
+      ptr_->addWeakRef();
+    }
+  }
+  WeakPtr(WeakPtr &&other) noexcept : ptr_{other.ptr_} {
+    other.ptr_ = nullptr;
+  }
+  WeakPtr(const WeakPtr &other) : WeakPtr{other.ptr_} {}
+  ~WeakPtr() {
+    if (ptr_) {
+      ptr_->releaseWeakRef();
+    }
+  }
+
+  WeakPtr &operator=(WeakPtr other) noexcept {
+    std::swap(ptr_, other.ptr_);
+    return *this;
+  }
+
+  IntrusivePtr<T> lock() const {
+    if (ptr_ && ptr_->tryAddRef()) {
+      return {ptr_, typename IntrusivePtr<T>::Adopt{}};
+    }
+    return {};
+  }
+
+ private:
+  T *ptr_ = nullptr;
+};
+
+// Type erased callable that stores callables of up to `Size` bytes inline
+template <class Signature, size_t Size = 3 * sizeof(void *)>
+class SmallFunction;
+
+template <class R, class... Args, size_t Size>
+class SmallFunction<R(Args...), Size> {
+ public:
+  SmallFunction() = default;
+
+  template <class F, class = std::enable_if_t<
+                         !std::is_same_v<std::decay_t<F>, SmallFunction>>>
+  SmallFunction(F &&fn) {
+    using Fn = std::decay_t<F>;
+    if constexpr (IsInline<Fn>) {
+      new (storage_) Fn(std::forward<F>(fn));
+    } else {
+      new (storage_) Fn *(new Fn(std::forward<F>(fn)));
+    }
+    ops_ = &OpsFor<Fn>;
+  }
+
+  SmallFunction(SmallFunction &&other) noexcept { steal(other); }
+
+  SmallFunction &operator=(SmallFunction &&other) noexcept {
+    if (this != &other) {
+      reset();
+      steal(other);
+    }
+    return *this;
+  }
+
+  SmallFunction(const SmallFunction &) = delete;
+  SmallFunction &operator=(const SmallFunction &) = delete;
+
+  ~SmallFunction() { reset(); }
+
+  R operator()(Args... args) const {
+    return ops_->invoke(storage_, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // The stored callable if it is of type Fn, nullptr otherwise
+  template <class Fn>
+  Fn *as() const {
+    return ops_ == &OpsFor<Fn> ? &target<Fn>(storage_) : nullptr;
+  }
+
+  void reset() {
+    if (ops_) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  struct Ops {
+    R (*invoke)(void *, Args &&...);
+    void (*move)(void *, void *) noexcept;
+    void (*destroy)(void *) noexcept;
+  };
+
+  template <class Fn>
+  static constexpr bool IsInline = sizeof(Fn) <= Size &&
+                                   alignof(Fn) <= alignof(void *) &&
+                                   std::is_nothrow_move_constructible_v<Fn>;
+
+  template <class Fn>
+  static Fn &target(void *storage) {
+    if constexpr (IsInline<Fn>) {
+      return *static_cast<Fn *>(storage);
+    } else {
+      return **static_cast<Fn **>(storage);
+    }
+  }
+
+  template <class Fn>
+  static constexpr Ops OpsFor = {
+      [](void *storage, Args &&... args) -> R {
+        return target<Fn>(storage)(std::forward<Args>(args)...);
+      },
+      [](void *from, void *to) noexcept {
+        if constexpr (IsInline<Fn>) {
+          new (to) Fn(std::move(target<Fn>(from)));
+          target<Fn>(from).~Fn();
+        } else {
+          new (to) Fn *(*static_cast<Fn **>(from));
+        }
+      },
+      [](void *storage) noexcept {
+        if constexpr (IsInline<Fn>) {
+          target<Fn>(storage).~Fn();
+        } else {
+          delete &target<Fn>(storage);
+        }
+      }};
+
+  void steal(SmallFunction &other) {
+    if (other.ops_) {
+      other.ops_->move(other.storage_, storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  alignas(void *) mutable unsigned char storage_[Size];
+  const Ops *ops_ = nullptr;
+};
+
+// Slots stored contiguously and addressed by IDs tagged with a generation, so
+// that the ID of a disconnected slot never matches the slot reusing its
+// entry. While slots are dispatched entries are neither moved nor destroyed:
+// disconnected slots are released and slots connected meanwhile are added
+// once the last dispatch has ended.
+template <class Function>
+class SlotTable {
+ public:
+  using IDType = std::uint64_t;
+  static constexpr IDType IDInvalid = 0;
+
+  SlotTable() = default;
+
+  // Takes over the slot of entry 0 with its generation, so its ID stays valid
+  SlotTable(Function &&fn, std::uint32_t generation) {
+    auto &slot = slots_.emplace_back();
+    slot.fn = std::move(fn);
+    slot.generation = generation;
+    if (generation & 1) {
+      ++connected_;
+    } else {
+      release(0);
+    }
+  }
+
+  IDType connect(Function &&fn) {
+    auto index = static_cast<std::uint32_t>(slots_.size() + pending_.size());
+    Slot *slot = nullptr;
+    if (dispatching_) {
+      slot = &pending_.emplace_back();
+    } else if (freeHead_ != NoIndex) {
+      index = freeHead_;
+      slot = &slots_[index];
+      freeHead_ = slot->nextFree;
+    } else {
+      slot = &slots_.emplace_back();
+    }
+    slot->fn = std::move(fn);
+    // odd generations are connected
+    ++slot->generation;
+    ++connected_;
+    return (IDType{slot->generation} << 32) | index;
+  }
+
+  void disconnect(IDType id) {
+    auto index = static_cast<std::uint32_t>(id);
+    auto slot = at(index);
+    if (!slot || slot->generation != static_cast<std::uint32_t>(id >> 32)) {
+      return;
+    }
+    ++slot->generation;
+    --connected_;
+    if (index >= slots_.size()) {
+      slot->fn.reset();
+    } else if (dispatching_) {
+      ++released_;
+    } else {
+      release(index);
+    }
+  }
+
+  bool connected() const { return connected_ != 0; }
+
+  // Room for `count` more entries
+  void reserve(size_t count) {
+    if (!dispatching_) {
+      slots_.reserve(slots_.size() + count);
+    }
+  }
+
+  // Number of entries to dispatch, slots connected from now on are not part
+  // of this dispatch
+  size_t beginDispatch() {
+    ++dispatching_;
+    return slots_.size();
+  }
+
+  const Function *slot(size_t index) const {
+    const auto &slot = slots_[index];
+    return slot.generation & 1 && slot.fn ? &slot.fn : nullptr;
+  }
+
+  Function *find(IDType id) {
+    auto slot = at(static_cast<std::uint32_t>(id));
+    return slot && slot->generation == static_cast<std::uint32_t>(id >> 32)
+               ? &slot->fn
+               : nullptr;
+  }
+
+  // First connected slot for which `pred(const Function &)` is true
+  template <class Pred>
+  Function *findIf(Pred &&pred) {
+    for (auto slots : {&slots_, &pending_}) {
+      for (auto &slot : *slots) {
+        if (slot.generation & 1 && slot.fn && pred(slot.fn)) {
+          return &slot.fn;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  void endDispatch() {
+    if (--dispatching_ != 0) {
+      return;
+    }
+    if (released_) {
+      for (size_t index = 0; index < slots_.size(); ++index) {
+        if (!(slots_[index].generation & 1) && slots_[index].fn) {
+          release(static_cast<std::uint32_t>(index));
+        }
+      }
+      released_ = 0;
+    }
+    for (auto &slot : pending_) {
+      slots_.push_back(std::move(slot));
+      if (!(slots_.back().generation & 1)) {
+        release(static_cast<std::uint32_t>(slots_.size() - 1));
+      }
+    }
+    pending_.clear();
+  }
+
+ private:
+  static constexpr std::uint32_t NoIndex = ~std::uint32_t{0};
+
+  struct Slot {
+    Function fn;
+    std::uint32_t generation = 0;
+    std::uint32_t nextFree = NoIndex;
+  };
+
+  Slot *at(std::uint32_t index) {
+    if (index < slots_.size()) {
+      return &slots_[index];
+    }
+    if (index - slots_.size() < pending_.size()) {
+      return &pending_[index - slots_.size()];
+    }
+    return nullptr;
+  }
+
+  void release(std::uint32_t index) {
+    slots_[index].fn.reset();
+    slots_[index].nextFree = freeHead_;
+    freeHead_ = index;
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<Slot> pending_;
+  std::uint32_t freeHead_ = NoIndex;
+  std::uint32_t connected_ = 0;
+  std::uint32_t released_ = 0;
+  std::uint32_t dispatching_ = 0;
+};
+
+// Typed slots of one value type, called by one slot of a signal that converts
+// each change once for all of them and drops the changes whose values compare
+// equal. The table is guarded by the mutex of the signal.
+template <class Tree, class T>
+class TypedSlots {
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using MutexType = typename Tree::MutexType;
+
+ public:
+  using SlotType = SmallFunction<void(const T &, const T &)>;
+  using TableType = SlotTable<SlotType>;
+
+  // The slot of the signal, the only owner
+  struct Slot {
+    std::unique_ptr<TypedSlots> slots;
+
+    void operator()(const PathType &, const NodeType &oldNode,
+                    const NodeType &newNode) const {
+      (*slots)(oldNode, newNode);
+    }
+  };
+
+  explicit TypedSlots(MutexType &mutex) : mutex_{mutex} {}
+
+  void operator()(const NodeType &oldNode, const NodeType &newNode) {
+    using TraitType = typename Tree::TraitType;
+    const auto oldValue = convert<TraitType, T, NodeType, PathType>(oldNode);
+    const auto newValue = convert<TraitType, T, NodeType, PathType>(newNode);
+    if constexpr (IsEqualityComparable<T>::value) {
+      if (oldValue == newValue) {
+        return;
+      }
+    }
+    struct Dispatch {
+      MutexType &mutex;
+      TableType &table;
+      size_t count;
+      ~Dispatch() {
+        LockGuard lock(mutex);
+        table.endDispatch();
+      }
+    };
+    auto dispatch = [&] {
+      LockGuard lock(mutex_);
+      return Dispatch{mutex_, table, table.beginDispatch()};
+    }();
+    for (size_t i = 0; i < dispatch.count; ++i) {
+      const SlotType *sl = nullptr;
+      {
+        LockGuard lock(mutex_);
+        sl = table.slot(i);
+      }
+      if (sl) {
+        (*sl)(oldValue, newValue);
+      }
+    }
+  }
+
+  TableType table;
+  typename TableType::IDType signalSlotID = TableType::IDInvalid;
+
+ private:
+  MutexType &mutex_;
+};
+
+}  // namespace detail
+
+// Signal of one observed path, a single allocation. On 64 bit targets with
+// NoEffectMutex it takes 64 bytes while it has at most one slot that fits in
+// SmallFunction: two 32 bit reference counts, the slot and its bookkeeping.
+// Other mutex types add their size and make the reference counts atomic. A
+// second slot moves all of them to a SlotTable of 64 bytes plus 40 per slot.
+template <class Tree>
+class ModificationSignal
+    : private detail::Compressed<typename Tree::MutexType>,
+      private detail::Compressed<
+          typename Tree::InstrumentationType::SignalState> {
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using SignalStateType = typename Tree::InstrumentationType::SignalState;
+  using SlotType = detail::SmallFunction<void(
+      const PathType &, const NodeType &, const NodeType &)>;
+  using SlotTableType = detail::SlotTable<SlotType>;
+  using SlotIDType = typename SlotTableType::IDType;
+  using MutexType = typename Tree::MutexType;
+  using RefCountType =
+      detail::RefCount<!std::is_same_v<MutexType, otree::NoEffectMutex>>;
+
+  static constexpr SlotIDType SlotIDInvalid = SlotTableType::IDInvalid;
+
+  class Connection {
+   public:
+    using SignalType = ModificationSignal<Tree>;
+    using SignalRefType = detail::WeakPtr<SignalType>;
+    using SlotIDType = typename SignalType::SlotIDType;
+
+    void disconnect() {
+      if (slotID_) {
+        if (auto sig = signalRef_.lock()) {
+          sig->disconnect(slotID_);
+        }
+      }
+    }
+
+    bool connected() const { return slotID_ != SlotIDInvalid; }
+
+    Connection(Connection &&other)
+        : signalRef_{std::move(other.signalRef_)}, slotID_{other.slotID_} {
+      other.slotID_ = SlotIDInvalid;
+    }
+
+    Connection &operator=(Connection &&other) {
+      signalRef_ = std::move(other.signalRef_);
+      slotID_ = other.slotID_;
+      other.slotID_ = SlotIDInvalid;
+      return *this;
+    }
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+   private:
+    friend class ModificationSignal;
+    Connection() = default;
+    Connection(SignalRefType &&sigref, SlotIDType slotID)
+        : signalRef_{std::move(sigref)}, slotID_{slotID} {}
+
+    SignalRefType signalRef_;
+    SlotIDType slotID_ = SlotIDInvalid;
+  };
+
+  // Connection of a slot of value type T, that may be its type's last one
+  template <class T>
+  class TypedConnection {
+   public:
+    using SignalType = ModificationSignal<Tree>;
+    using SignalRefType = detail::WeakPtr<SignalType>;
+    using SlotIDType = typename SignalType::SlotIDType;
+
+    void disconnect() {
+      if (slotID_) {
+        if (auto sig = signalRef_.lock()) {
+          sig->template disconnect<T>(typedID_, slotID_);
+        }
+      }
+    }
+
+    bool connected() const { return slotID_ != SlotIDInvalid; }
+
+    TypedConnection(TypedConnection &&other)
+        : signalRef_{std::move(other.signalRef_)},
+          typedID_{other.typedID_},
+          slotID_{other.slotID_} {
+      other.slotID_ = SlotIDInvalid;
+    }
+
+    TypedConnection &operator=(TypedConnection &&other) {
+      signalRef_ = std::move(other.signalRef_);
+      typedID_ = other.typedID_;
+      slotID_ = other.slotID_;
+      other.slotID_ = SlotIDInvalid;
+      return *this;
+    }
+
+    TypedConnection(const TypedConnection &) = delete;
+    TypedConnection &operator=(const TypedConnection &) = delete;
+
+   private:
+    friend class ModificationSignal;
+    TypedConnection() = default;
+    TypedConnection(SignalRefType &&sigref, SlotIDType typedID,
+                    SlotIDType slotID)
+        : signalRef_{std::move(sigref)}, typedID_{typedID}, slotID_{slotID} {}
+
+    SignalRefType signalRef_;
+    // the slot of this signal calling the typed slots
+    SlotIDType typedID_ = SlotIDInvalid;
+    SlotIDType slotID_ = SlotIDInvalid;
+  };
+
+  using MultiSlots = std::unique_ptr<SlotTableType>;
+
+  // The only slot, connected while its generation is odd. Its ID is the one
+  // of entry 0 of a SlotTable. Slots connected while it is dispatched are
+  // kept in `upgrade`, which replaces it when the last dispatch has ended.
+  struct SingleSlot {
+    SlotType fn;
+    std::uint32_t generation = 0;
+    std::uint32_t dispatching = 0;
+    MultiSlots upgrade;
+  };
+
+ public:
+  // Callables small enough are stored inline in the slot table, empty
+  // functions and null pointers are not connected. A slot is called with the
+  // old and the new node, or with the path, the old and the new node. The
+  // path is the one matched by a wildcard subscription and empty otherwise.
+  template <class F>
+  Connection connect(F &&sl) {
+    if constexpr (std::is_same_v<std::decay_t<F>, std::nullptr_t>) {
+      return {};
+    } else {
+      if constexpr (!std::is_function_v<std::remove_reference_t<F>> &&
+                    std::is_constructible_v<bool, const F &>) {
+        if (!static_cast<bool>(sl)) {
+          return {};
+        }
+      }
+      auto slotID = SlotIDInvalid;
+      if constexpr (std::is_invocable_v<F &, const PathType &,
+                                        const NodeType &, const NodeType &>) {
+        LockGuard lock(mutex());
+        slotID = connectSlot(SlotType{std::forward<F>(sl)});
+      } else {
+        auto slot = [fn = std::forward<F>(sl)](
+                        const PathType &, const NodeType &jOld,
+                        const NodeType &jNew) mutable { fn(jOld, jNew); };
+        LockGuard lock(mutex());
+        slotID = connectSlot(SlotType{std::move(slot)});
+      }
+      return Connection{typename Connection::SignalRefType{this}, slotID};
+    }
+  }
+
+  // Room for `slots` more slots: a signal that is about to have several moves
+  // to a slot table once, sized for them
+  void reserve(size_t slots) {
+    LockGuard lock(mutex());
+    if (auto single = std::get_if<SingleSlot>(&slots_)) {
+      slots += single->generation & 1;
+      if (slots < 2 || single->dispatching) {
+        return;
+      }
+      auto table = std::make_unique<SlotTableType>(std::move(single->fn),
+                                                   single->generation);
+      table->reserve(slots);
+      slots_ = std::move(table);
+    } else {
+      std::get<MultiSlots>(slots_)->reserve(slots);
+    }
+  }
+
+  // Connects the slot returned by `adaptor.wrap<Tree>(sl)`, e.g. Coalesce
+  template <class F, class Adaptor>
+  Connection connect(F &&sl, const Adaptor &adaptor) {
+    return connect(adaptor.template wrap<Tree>(std::forward<F>(sl)));
+  }
+
+  // Connects `sl(const T &oldValue, const T &newValue)`. The slots of one value
+  // type share a slot of the signal, which converts each change once with
+  // Trait::Impl<T>::get, or Trait::get<T> at the empty path, and does not call
+  // them if the values compare equal, e.g. for the json numbers 1 and 1.0.
+  template <class T, class F>
+  TypedConnection<T> connect(F &&sl) {
+    using TypedSlotsType = detail::TypedSlots<Tree, T>;
+    if constexpr (std::is_same_v<std::decay_t<F>, std::nullptr_t>) {
+      return {};
+    } else {
+      if constexpr (!std::is_function_v<std::remove_reference_t<F>> &&
+                    std::is_constructible_v<bool, const F &>) {
+        if (!static_cast<bool>(sl)) {
+          return {};
+        }
+      }
+      auto typedSlot = typename TypedSlotsType::SlotType{std::forward<F>(sl)};
+      LockGuard lock(mutex());
+      auto typed = findTyped<T>();
+      if (!typed) {
+        auto slots = std::make_unique<TypedSlotsType>(mutex());
+        typed = slots.get();
+        typed->signalSlotID = connectSlot(
+            SlotType{typename TypedSlotsType::Slot{std::move(slots)}});
+      }
+      auto slotID = typed->table.connect(std::move(typedSlot));
+      using SignalRefType = typename TypedConnection<T>::SignalRefType;
+      return TypedConnection<T>{SignalRefType{this}, typed->signalSlotID,
+                                slotID};
+    }
+  }
+
+  // Counters of the instrumentation policy, e.g. SignalStats
+  auto stats() const { return signalState().stats(); }
+
+ private:
+  template <class TreeClass>
+  friend class SignalMgr;
+  template <class TreeClass>
+  friend class NotificationQueue;
+  template <class TreeClass>
+  friend class DiffContext;
+  template <class T>
+  friend class detail::IntrusivePtr;
+  template <class T>
+  friend class detail::WeakPtr;
+
+  // The strong references together hold one weak reference
+  ModificationSignal() = default;
+  ModificationSignal(const ModificationSignal &) = delete;
+  ModificationSignal &operator=(const ModificationSignal &) = delete;
+
+  static SlotIDType singleID(std::uint32_t generation) {
+    return SlotIDType{generation} << 32;
+  }
+
+  MutexType &mutex() const {
+    return static_cast<const detail::Compressed<MutexType> &>(*this).get();
+  }
+
+  SignalStateType &signalState() const {
+    return static_cast<const detail::Compressed<SignalStateType> &>(*this)
+        .get();
+  }
+
+  void addRef() { strong_.increment(); }
+  void release() {
+    if (strong_.decrement()) {
+      slots_ = SingleSlot{};
+      releaseWeakRef();
+    }
+  }
+  long useCount() const { return strong_.get(); }
+  void addWeakRef() { weak_.increment(); }
+  void releaseWeakRef() {
+    if (weak_.decrement()) {
+      delete this;
+    }
+  }
+  bool tryAddRef() { return strong_.incrementIfNotZero(); }
+
+  SlotIDType connectSlot(SlotType &&fn) {
+    if (auto single = std::get_if<SingleSlot>(&slots_)) {
+      if (single->dispatching) {
+        if (!single->upgrade) {
+          single->upgrade =
+              std::make_unique<SlotTableType>(SlotType{}, single->generation);
+        }
+        return single->upgrade->connect(std::move(fn));
+      }
+      if (!(single->generation & 1)) {
+        single->fn = std::move(fn);
+        return singleID(++single->generation);
+      }
+      auto table = std::make_unique<SlotTableType>(std::move(single->fn),
+                                                   single->generation);
+      slots_ = std::move(table);
+    }
+    return std::get<MultiSlots>(slots_)->connect(std::move(fn));
+  }
+
+  bool connected() const {
+    LockGuard lock(mutex());
+    if (auto single = std::get_if<SingleSlot>(&slots_)) {
+      return (single->generation & 1) ||
+             (single->upgrade && single->upgrade->connected());
+    }
+    return std::get<MultiSlots>(slots_)->connected();
+  }
+
+  void disconnect(SlotIDType slotID) {
+    LockGuard lock(mutex());
+    disconnectSlot(slotID);
+  }
+
+  // The slot calling the typed slots goes with the last of them
+  template <class T>
+  void disconnect(SlotIDType typedID, SlotIDType slotID) {
+    LockGuard lock(mutex());
+    if (auto typed = findTyped<T>(); typed && typed->signalSlotID == typedID) {
+      typed->table.disconnect(slotID);
+      if (!typed->table.connected()) {
+        disconnectSlot(typedID);
+      }
+    }
+  }
+
+  template <class T>
+  detail::TypedSlots<Tree, T> *findTyped() {
+    using TypedSlot = typename detail::TypedSlots<Tree, T>::Slot;
+    auto isTyped = [](const SlotType &fn) {
+      return fn.template as<TypedSlot>() != nullptr;
+    };
+    SlotType *slot = nullptr;
+    if (auto single = std::get_if<SingleSlot>(&slots_)) {
+      if (single->generation & 1 && isTyped(single->fn)) {
+        slot = &single->fn;
+      } else if (single->upgrade) {
+        slot = single->upgrade->findIf(isTyped);
+      }
+    } else {
+      slot = std::get<MultiSlots>(slots_)->findIf(isTyped);
+    }
+    return slot ? slot->template as<TypedSlot>()->slots.get() : nullptr;
+  }
+
+  void disconnectSlot(SlotIDType slotID) {
+    if (auto single = std::get_if<SingleSlot>(&slots_)) {
+      if (single->upgrade) {
+        single->upgrade->disconnect(slotID);
+      }
+      if (slotID == singleID(single->generation)) {
+        ++single->generation;
+        if (!single->dispatching) {
+          single->fn.reset();
+        }
+      }
+    } else {
+      std::get<MultiSlots>(slots_)->disconnect(slotID);
+    }
+  }
+
+  // Slots are called without holding the mutex so that they may connect to
+  // or disconnect from this signal. A slot disconnected during the dispatch is
+  // not called anymore, one connected during it is called from the next one.
+  void operator()(const PathType &path, const NodeType &jOld,
+                  const NodeType &jNew) {
+    SlotTableType *table = nullptr;
+    {
+      LockGuard lock(mutex());
+      if (auto single = std::get_if<SingleSlot>(&slots_)) {
+        if (!(single->generation & 1)) {
+          return;
+        }
+        ++single->dispatching;
+      } else {
+        table = std::get<MultiSlots>(slots_).get();
+      }
+    }
+    signalState().onFire();
+    if (table) {
+      dispatch(*table, path, jOld, jNew);
+    } else {
+      dispatch(std::get<SingleSlot>(slots_), path, jOld, jNew);
+    }
+  }
+
+  // The slot stays in place until its dispatch has ended
+  void dispatch(SingleSlot &single, const PathType &path,
+                const NodeType &jOld, const NodeType &jNew) {
+    struct Dispatch {
+      ModificationSignal &signal;
+      SingleSlot &single;
+      ~Dispatch() {
+        LockGuard lock(signal.mutex());
+        if (--single.dispatching == 0) {
+          signal.endDispatch(single);
+        }
+      }
+    };
+    auto dispatch = Dispatch{*this, single};
+    invoke(dispatch.single.fn, path, jOld, jNew);
+  }
+
+  void endDispatch(SingleSlot &single) {
+    if (!(single.generation & 1)) {
+      single.fn.reset();
+    }
+    if (auto table = std::move(single.upgrade)) {
+      if (auto slot = table->find(singleID(single.generation))) {
+        *slot = std::move(single.fn);
+      }
+      slots_ = std::move(table);
+    }
+  }
+
+  // The table is never replaced once created
+  void dispatch(SlotTableType &table, const PathType &path,
+                const NodeType &jOld, const NodeType &jNew) {
+    struct Dispatch {
+      ModificationSignal &signal;
+      SlotTableType &table;
+      size_t count;
+      ~Dispatch() {
+        LockGuard lock(signal.mutex());
+        table.endDispatch();
+      }
+    };
+    auto dispatch = [&] {
+      LockGuard lock(mutex());
+      return Dispatch{*this, table, table.beginDispatch()};
+    }();
+    for (size_t i = 0; i < dispatch.count; ++i) {
+      const SlotType *sl = nullptr;
+      {
+        LockGuard lock(mutex());
+        sl = table.slot(i);
+      }
+      if (sl) {
+        invoke(*sl, path, jOld, jNew);
+      }
+    }
+  }
+
+  void invoke(const SlotType &sl, const PathType &path, const NodeType &jOld,
+              const NodeType &jNew) {
+    if constexpr (Tree::InstrumentationType::Timed) {
+      auto start = Tree::InstrumentationType::Clock::now();
+      sl(path, jOld, jNew);
+      signalState().onSlot(Tree::InstrumentationType::Clock::now() - start);
+    } else {
+      sl(path, jOld, jNew);
+    }
+  }
+
+  RefCountType strong_{0};
+  RefCountType weak_{1};
+  std::variant<SingleSlot, MultiSlots> slots_;
+};
+
+template <class Tree>
+using SignalPtr = detail::IntrusivePtr<ModificationSignal<Tree>>;
+
+// Policies for the container that holds the subscriptions of one tree level,
+// and for the store of the levels. FlatIndex diffs faster but moves entries on
+// insert, so slots must not subscribe to new paths of the same tree while it
+// is being diffed. Its levels are allocated from an arena of the tree. The
+// signals are allocated one by one with both: their connections may outlive
+// the tree.
+struct MapIndex {
+  template <class Key, class Value>
+  using Type = std::map<Key, Value>;
+};
+
+struct FlatIndex {
+  template <class Key, class Value>
+  using Type = detail::FlatMap<Key, Value>;
+  template <class Level>
+  using Levels = detail::ArenaLevels<Level>;
+};
+
+using Executor = std::function<void(std::function<void()>)>;
+
+namespace detail {
+
+// Functions posted by slots that must not run under a tree lock, e.g. the
+// resumption of a coroutine that may read the tree. Each update of a tree
+// holds a scope, the functions posted while the thread runs updates are run
+// once the outermost one released its lock and dispatched its slots.
+class AfterUpdate {
+ public:
+  AfterUpdate() { ++local().depth; }
+  ~AfterUpdate() {
+    auto &state = local();
+    if (--state.depth) {
+      return;
+    }
+    while (!state.pending.empty()) {
+      auto batch = std::move(state.pending);
+      state.pending.clear();
+      for (auto &fn : batch) {
+        fn();
+      }
+    }
+  }
+
+  AfterUpdate(const AfterUpdate &) = delete;
+  AfterUpdate &operator=(const AfterUpdate &) = delete;
+
+  // Runs `fn` at once on a thread not updating a tree
+  static void post(std::function<void()> fn) {
+    auto &state = local();
+    if (state.depth) {
+      state.pending.push_back(std::move(fn));
+    } else {
+      fn();
+    }
+  }
+
+ private:
+  struct State {
+    size_t depth = 0;
+    std::vector<std::function<void()>> pending;
+  };
+
+  static State &local() {
+    thread_local State state;
+    return state;
+  }
+};
+
+}  // namespace detail
+
+enum class DispatchMode : char { Immediate, Deferred };
+
+// Opt-in parallel diff of large subscription levels: a level with at least
+// `minEntries` observed keys is split into ranges of keys diffed as tasks, up
+// to `workers` posted to `executor` and the updating thread taking the rest.
+// Slots are called, or deferred, after all tasks ended and in the order of a
+// serial diff. The trait must allow concurrent reads of nodes.
+struct ParallelDiff {
+  Executor executor;
+  size_t workers = 3;
+  size_t minEntries = 64;
+};
+
+namespace detail {
+
+template <class Policy, class = void>
+struct HasMerge : std::false_type {};
+
+template <class Policy>
+struct HasMerge<Policy, std::void_t<decltype(std::declval<Policy &>().merge(
+                            std::declval<const Policy &>()))>>
+    : std::true_type {};
+
+// Runs `run(index)` for the indexes below `count` on this thread and on up to
+// `workers` helpers posted to `executor`, each taking the next index when done
+// with one. Returns when all have run, helpers started later do nothing.
+template <class Run>
+void runTasks(const Executor &executor, size_t workers, size_t count,
+              Run &run) {
+  struct State {
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t finished = 0;
+  };
+  auto state = std::make_shared<State>();
+  auto work = [state, &run, count] {
+    for (auto index = state->next++; index < count; index = state->next++) {
+      run(index);
+      LockGuard lock(state->mutex);
+      if (++state->finished == count) {
+        state->done.notify_one();
+      }
+    }
+  };
+  for (size_t i = 1; i < std::min(workers + 1, count); ++i) {
+    executor(work);
+  }
+  work();
+  auto lock = std::unique_lock<std::mutex>{state->mutex};
+  state->done.wait(lock, [&] { return state->finished == count; });
+}
+
+}  // namespace detail
+
+template <class Tree>
+struct Notification {
+  SignalPtr<Tree> signal;
+  typename Tree::PathType path;
+  typename Tree::NodeType oldNode;
+  typename Tree::NodeType newNode;
+};
+
+template <class Tree>
+using NotificationList = std::vector<Notification<Tree>>;
+
+// Observed: the changes of the subscribed paths, as the subscriptions are
+// notified. All: the leaf-most changes of the whole tree, i.e. the changed
+// nodes none of whose children changed, or that were added, removed or
+// replaced by a node without children. Only nodes that are objects before and
+// after are split into their children. Patch: the records of All, used as a
+// patch: writing each new node at its path, or erasing the path if the new
+// node is empty, turns the old root into the new one.
+enum class ChangeScope : char { Observed, All, Patch };
+
+template <class Tree>
+struct Change {
+  typename Tree::PathType path;
+  typename Tree::NodeType oldNode;
+  typename Tree::NodeType newNode;
+};
+
+template <class Tree>
+using ChangeSet = std::vector<Change<Tree>>;
+
+// Cleanup of the subscription index: signals released because they had no
+// slots and no owner besides the index, and index entries erased because
+// nothing was left at or below them
+struct PruneCounts {
+  size_t signals = 0;
+  size_t entries = 0;
+
+  PruneCounts &operator+=(const PruneCounts &other) {
+    signals += other.signals;
+    entries += other.entries;
+    return *this;
+  }
+};
+
+// State of one diff pass: notifications are either fired right away or
+// recorded to be dispatched after the tree lock has been released
+template <class Tree>
+class DiffContext {
+ public:
+  using SignalPtrType = SignalPtr<Tree>;
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using KeyType = typename Tree::KeyType;
+  using InstrumentationType = typename Tree::InstrumentationType;
+
+  // Notification collected by a parallel diff task. The nodes found through
+  // getChild outlive the task, they are borrowed.
+  struct Collected {
+    using NodeRef = std::conditional_t<
+        detail::HasGetChild<typename Tree::TraitType, NodeType, KeyType>::value,
+        const NodeType *, NodeType>;
+
+    SignalPtrType signal;
+    PathType path;
+    NodeRef oldNode;
+    NodeRef newNode;
+  };
+  using CollectedList = std::vector<Collected>;
+
+  DiffContext(InstrumentationType &instrumentation,
+              NotificationList<Tree> *deferred = nullptr)
+      : instrumentation_{instrumentation}, deferred_{deferred} {}
+
+  PruneCounts &pruned() { return pruned_; }
+  InstrumentationType &instrumentation() { return instrumentation_; }
+
+  void diffInParallel(const ParallelDiff *parallel) { parallel_ = parallel; }
+  const ParallelDiff *parallel() const { return parallel_; }
+
+  // Tree version of the write being diffed
+  void setVersion(std::uint64_t version) { version_ = version; }
+  std::uint64_t version() const { return version_; }
+
+  // Context of a task diffing part of a level in parallel, at the same keys.
+  // Its notifications and changes are collected, to be joined in task order.
+  DiffContext fork(InstrumentationType &instrumentation,
+                   CollectedList &notifications,
+                   ChangeSet<Tree> &changes) const {
+    auto task = DiffContext{instrumentation};
+    task.collected_ = &notifications;
+    task.keys_ = keys_;
+    task.matching_ = matching_;
+    task.version_ = version_;
+    if (changes_) {
+      task.recordChanges(&changes, scope_);
+      task.recordingPaused_ = recordingPaused_;
+    }
+    return task;
+  }
+
+  // Notifications were counted by the task
+  void join(InstrumentationType &instrumentation,
+            CollectedList &notifications, ChangeSet<Tree> &changes,
+            const PruneCounts &pruned) {
+    if constexpr (detail::HasMerge<InstrumentationType>::value) {
+      instrumentation_.merge(instrumentation);
+    }
+    pruned_ += pruned;
+    if (changes_) {
+      std::move(changes.begin(), changes.end(), std::back_inserter(*changes_));
+    }
+    for (auto &notification : notifications) {
+      const auto &oldNode = node(notification.oldNode);
+      const auto &newNode = node(notification.newNode);
+      if (deferred_) {
+        deferred_->push_back({std::move(notification.signal),
+                              std::move(notification.path), oldNode, newNode});
+      } else {
+        (*notification.signal)(notification.path, oldNode, newNode);
+      }
+    }
+  }
+
+  void notify(const SignalPtrType &signal, const NodeType &oldNode,
+              const NodeType &newNode) {
+    notify(signal, detail::emptyNode<PathType>(), oldNode, newNode);
+  }
+
+  void notify(const SignalPtrType &signal, const PathType &path,
+              const NodeType &oldNode, const NodeType &newNode) {
+    instrumentation_.onNotify();
+    if (collected_) {
+      collected_->push_back(
+          {signal, path, collect(oldNode), collect(newNode)});
+    } else if (deferred_) {
+      deferred_->push_back({signal, path, oldNode, newNode});
+    } else {
+      (*signal)(path, oldNode, newNode);
+    }
+  }
+
+  // Keys from the root to the node being diffed, maintained only when the
+  // trait supports wildcards. Below a key matched by a wildcard
+  // notifications carry the path.
+  void pushKey(const KeyType &key) { keys_.push_back(&key); }
+  void popKey() { keys_.pop_back(); }
+  void beginMatch() { ++matching_; }
+  void endMatch() { --matching_; }
+
+  void notifyAt(const SignalPtrType &signal, const NodeType &oldNode,
+                const NodeType &newNode) {
+    if (matching_) {
+      notify(signal, path(), oldNode, newNode);
+    } else {
+      notify(signal, oldNode, newNode);
+    }
+  }
+
+  PathType path() const {
+    return detail::makePath<TraitType, PathType>(keys_);
+  }
+
+  void recordChanges(ChangeSet<Tree> *changes, ChangeScope scope) {
+    changes_ = changes;
+    scope_ = scope;
+  }
+
+  // True if the keys must be maintained to record the observed changes
+  bool recordsObserved() const {
+    return changes_ && scope_ == ChangeScope::Observed;
+  }
+
+  // The node of an observed path changed: records it and notifies the slots
+  void changedAt(const SignalPtrType &signal, const NodeType &oldNode,
+                 const NodeType &newNode) {
+    if (recordsObserved()) {
+      record(oldNode, newNode);
+    }
+    if (signal->connected()) {
+      notifyAt(signal, oldNode, newNode);
+    }
+  }
+
+  // True if all changes are recorded and the level being diffed records its
+  // own. The diff then walks all the children of the level, recording those
+  // that are not observed with recordBelow(), so that each node is compared
+  // once for both the notifications and the records.
+  bool recordsAll() const {
+    return changes_ && scope_ != ChangeScope::Observed && !recordingPaused_;
+  }
+
+  // While paused the levels diffed are below a node that is recorded whole
+  void pauseRecording(bool paused) { recordingPaused_ = paused; }
+
+  // True if the changes below the nodes are recorded instead of the nodes,
+  // when both have children. A node replaced by one without children is
+  // recorded whole, so that its new value is part of the records. Without
+  // forEachChild and getChild nodes are recorded whole.
+  bool splits(const NodeType &oldNode, const NodeType &newNode) const {
+    if constexpr (CanWalkChildren) {
+      return detail::isObject<TraitType, NodeType, KeyType>(oldNode) &&
+             detail::isObject<TraitType, NodeType, KeyType>(newNode);
+    } else {
+      return false;
+    }
+  }
+
+  // Records the nodes if they changed and `diffBelow()`, which diffs the
+  // level below them and returns true if it changed, recorded nothing.
+  // Returns true if the nodes changed.
+  template <class DiffBelow>
+  bool recordAt(const NodeType &oldNode, const NodeType &newNode,
+                DiffBelow &&diffBelow) {
+    auto recorded = changes_->size();
+    auto changed = diffBelow() || this->changed(oldNode, newNode);
+    if (changed && changes_->size() == recorded) {
+      record(oldNode, newNode);
+    }
+    return changed;
+  }
+
+  // Records the leaf-most changes below unobserved nodes, returns false if
+  // the nodes are equal
+  bool recordBelow(const NodeType &oldNode, const NodeType &newNode) {
+    if (!changed(oldNode, newNode)) {
+      return false;
+    }
+    auto recorded = false;
+    if constexpr (CanWalkChildren) {
+      if (splits(oldNode, newNode)) {
+        auto at = [&](const KeyType &key, const NodeType &oldChild,
+                      const NodeType &newChild) {
+          pushKey(key);
+          recorded |= recordBelow(oldChild, newChild);
+          popKey();
+        };
+        // Only the child found by getChild is compared when keys are repeated
+        TraitType::forEachChild(
+            oldNode, [&](const KeyType &key, const NodeType &oldChild) {
+              if (TraitType::getChild(oldNode, key) == &oldChild) {
+                at(key, oldChild, *ChildRefType{newNode, key});
+              }
+            });
+        TraitType::forEachChild(
+            newNode, [&](const KeyType &key, const NodeType &newChild) {
+              if (!TraitType::getChild(oldNode, key) &&
+                  TraitType::getChild(newNode, key) == &newChild) {
+                at(key, detail::emptyNode<NodeType>(), newChild);
+              }
+            });
+      }
+    }
+    if (!recorded) {
+      record(oldNode, newNode);
+    }
+    return true;
+  }
+
+  // Compares nodes that are observed or recorded
+  bool changed(const NodeType &oldNode, const NodeType &newNode) {
+    instrumentation_.onCompare();
+    if (detail::identical<TraitType>(oldNode, newNode)) {
+      return false;
+    }
+    if constexpr (detail::HasHash<TraitType, NodeType>::value) {
+      if (TraitType::hash(oldNode) != TraitType::hash(newNode)) {
+        return true;
+      }
+    }
+    instrumentation_.onEquality();
+    return !TraitType::equal(oldNode, newNode);
+  }
+
+  using Children = std::vector<std::pair<const KeyType *, const NodeType *>>;
+
+  // Scratch buffers for the children of the levels being diffed, reused
+  // across the levels of a pass. Buffers are released in reverse order.
+  Children &acquireChildren() {
+    if (usedChildren_ == children_.size()) {
+      children_.emplace_back();
+    }
+    auto &children = children_[usedChildren_++];
+    children.clear();
+    return children;
+  }
+  void releaseChildren(size_t count) { usedChildren_ -= count; }
+
+ private:
+  using TraitType = typename Tree::TraitType;
+  using ChildRefType = detail::ChildRef<TraitType, NodeType, KeyType>;
+
+  static constexpr bool CanWalkChildren =
+      detail::HasForEachChild<TraitType, NodeType, KeyType>::value &&
+      detail::HasGetChild<TraitType, NodeType, KeyType>::value;
+
+  static typename Collected::NodeRef collect(const NodeType &node) {
+    if constexpr (std::is_pointer_v<typename Collected::NodeRef>) {
+      return &node;
+    } else {
+      return node;
+    }
+  }
+
+  static const NodeType &node(const NodeType *node) { return *node; }
+  static const NodeType &node(const NodeType &node) { return node; }
+
+  void record(const NodeType &oldNode, const NodeType &newNode) {
+    if constexpr (detail::canMakePath<TraitType, PathType, KeyType>()) {
+      changes_->push_back({path(), oldNode, newNode});
+    }
+  }
+
+  InstrumentationType &instrumentation_;
+  NotificationList<Tree> *deferred_;
+  CollectedList *collected_ = nullptr;
+  const ParallelDiff *parallel_ = nullptr;
+  PruneCounts pruned_;
+  std::vector<const KeyType *> keys_;
+  size_t matching_ = 0;
+  std::uint64_t version_ = 0;
+  ChangeSet<Tree> *changes_ = nullptr;
+  ChangeScope scope_ = ChangeScope::Observed;
+  bool recordingPaused_ = false;
+  std::deque<Children> children_;
+  size_t usedChildren_ = 0;
+};
+
+// Runs posted batches of notifications one at a time in FIFO order, so the
+// order of notifications of each path is the order of the tree updates
+template <class Tree>
+class NotificationQueue
+    : public std::enable_shared_from_this<NotificationQueue<Tree>> {
+  using MutexType = typename Tree::MutexType;
+
+ public:
+  void setExecutor(Executor executor) {
+    LockGuard lock(mutex_);
+    executor_ = std::move(executor);
+  }
+
+  // Returns true if the caller must call run() once it released its locks
+  bool post(NotificationList<Tree> &&batch) {
+    LockGuard lock(mutex_);
+    pending_.push_back(std::move(batch));
+    if (running_) {
+      return false;
+    }
+    running_ = true;
+    return true;
+  }
+
+  void run() {
+    auto executor = Executor{};
+    {
+      LockGuard lock(mutex_);
+      executor = executor_;
+    }
+    if (executor) {
+      executor([self = this->shared_from_this()] { self->drain(); });
+    } else {
+      drain();
+    }
+  }
+
+ private:
+  void drain() {
+    while (true) {
+      auto batch = NotificationList<Tree>{};
+      {
+        LockGuard lock(mutex_);
+        if (pending_.empty()) {
+          running_ = false;
+          return;
+        }
+        batch = std::move(pending_.front());
+        pending_.pop_front();
+      }
+      for (auto &notification : batch) {
+        (*notification.signal)(notification.path, notification.oldNode,
+                               notification.newNode);
+      }
+    }
+  }
+
+  std::list<NotificationList<Tree>> pending_;
+  Executor executor_;
+  bool running_ = false;
+  MutexType mutex_;
+};
+
+template <class Tree>
+class SignalMgr {
+  struct MySignalAndChild;
+
+ public:
+  using SignalType = ModificationSignal<Tree>;
+  using PathType = typename Tree::PathType;
+  using KeyType = typename Tree::KeyType;
+  using TraitType = typename Tree::TraitType;
+  using NodeType = typename Tree::NodeType;
+  using SignalPtrType = SignalPtr<Tree>;
+  using ChildRefType = detail::ChildRef<TraitType, NodeType, KeyType>;
+  using DiffContextType = DiffContext<Tree>;
+  using LevelsType =
+      typename detail::LevelsOf<typename Tree::IndexType, SignalMgr>::Type;
+
+  explicit SignalMgr(LevelsType &levels) : levels_{&levels} {}
+
+  static constexpr bool CanWalkChildren =
+      detail::HasForEachChild<TraitType, NodeType, KeyType>::value &&
+      detail::HasGetChild<TraitType, NodeType, KeyType>::value;
+  static constexpr bool HasWildcards =
+      CanWalkChildren && std::is_constructible_v<KeyType, const char *>;
+
+  // A new signal starts at the tree `version`
+  SignalPtrType createSignal(const PathType &path, std::uint64_t version) {
+    using namespace std;
+    //    using std::begin;
+    //    using std::end;
+    auto ibeg = begin(path);
+    auto iend = end(path);
+    if (ibeg != iend) {
+      return createSignal(ibeg, iend, version);
+    }
+    return {};
+  }
+
+  // createSignal() of each of `paths`, which must not be empty, into
+  // `signals`. Only the keys below those a path shares with the previous one
+  // are looked up, so paths grouped by prefix, e.g. sorted, skip most lookups.
+  void createSignals(const std::vector<const PathType *> &paths,
+                     std::uint64_t version,
+                     std::vector<SignalPtrType> &signals) {
+    // keys of the previous path with the level holding each of them
+    auto keys = std::vector<const KeyType *>{};
+    auto levels = std::vector<SignalMgr *>{};
+    for (auto path : paths) {
+      using std::begin;
+      using std::end;
+      auto it = begin(*path);
+      auto last = end(*path);
+      auto depth = size_t{0};
+      while (depth + 1 < keys.size() && std::next(it) != last &&
+             *keys[depth] == *it) {
+        ++it;
+        ++depth;
+      }
+      keys.resize(depth);
+      levels.resize(depth + 1, this);
+      while (true) {
+        auto level = levels.back();
+        const auto &key = *it;
+        if constexpr (HasWildcards) {
+          level->hasWildcards_ |=
+              detail::wildcard<KeyType>(key) != detail::Wildcard::None;
+        }
+        auto &subAndSig = level->signalsMap_[key];
+        keys.push_back(&key);
+        if (++it == last) {
+          if (!subAndSig.signalPtr_) {
+            subAndSig.signalPtr_ = SignalPtrType{new SignalType};
+            subAndSig.version_ = version;
+          }
+          signals.push_back(subAndSig.signalPtr_);
+          break;
+        }
+        if (!subAndSig.child_) {
+          subAndSig.child_ = level->levels_->create();
+        }
+        levels.push_back(subAndSig.child_.get());
+      }
+    }
+  }
+
+  bool onChanged(const NodeType &oldNode, const NodeType &newNode,
+                 DiffContextType &ctx) {
+    if (detail::identical<TraitType>(oldNode, newNode) ||
+        (TraitType::empty(oldNode) && TraitType::empty(newNode))) {
+      return false;
+    }
+    ctx.instrumentation().onDiff();
+    if (ctx.recordsAll()) {
+      if constexpr (CanWalkChildren) {
+        if (ctx.splits(oldNode, newNode)) {
+          return onChangedByChildren(oldNode, newNode, ctx);
+        }
+      }
+      // the nodes are recorded whole by the level above
+      ctx.pauseRecording(true);
+      auto changed = onChangedByWalk(oldNode, newNode, ctx);
+      ctx.pauseRecording(false);
+      return changed;
+    }
+    return onChangedByWalk(oldNode, newNode, ctx);
+  }
+
+  // Erases the unused entries of the whole index, not only of the visited
+  // subtrees as a diff does
+  void prune(PruneCounts &counts) {
+    for (auto it = signalsMap_.begin(); it != signalsMap_.end();) {
+      if (it->second.child_) {
+        it->second.child_->prune(counts);
+      }
+      it = releaseUnused(it, counts);
+    }
+  }
+
+  SignalPtrType getSignal(const PathType &path) {
+    using std::begin;
+    using std::end;
+    auto ibeg = begin(path);
+    auto iend = end(path);
+    if (ibeg != iend) {
+      if (auto sigNChild = getSigNChild(ibeg, iend)) {
+        return sigNChild->signalPtr_;
+      }
+    }
+    return {};
+  }
+
+  using KeyList = std::vector<KeyType>;
+
+  // Parsed path and the subscription entries along it, up to the deepest
+  // observed key. The entries stay valid until subscriptions are removed or
+  // added.
+  struct Route {
+    KeyList keys;
+    std::vector<MySignalAndChild *> chain;
+  };
+
+  Route route(const PathType &path) {
+    using std::begin;
+    using std::end;
+    auto r = Route{};
+    for (auto it = begin(path), iend = end(path); it != iend; ++it) {
+      r.keys.push_back(*it);
+    }
+    refresh(r);
+    return r;
+  }
+
+  // Version of the signal of the route's path, `treeVersion` if it has none
+  static std::uint64_t version(const Route &r, std::uint64_t treeVersion) {
+    if (r.chain.empty() || r.chain.size() != r.keys.size()) {
+      return treeVersion;
+    }
+    return version(*r.chain.back(), treeVersion);
+  }
+
+  std::uint64_t version(const PathType &path, std::uint64_t treeVersion) {
+    using std::begin;
+    using std::end;
+    auto ibeg = begin(path);
+    auto iend = end(path);
+    if (ibeg != iend) {
+      if (auto sigNChild = getSigNChild(ibeg, iend)) {
+        return version(*sigNChild, treeVersion);
+      }
+    }
+    return treeVersion;
+  }
+
+  void refresh(Route &r) {
+    r.chain.clear();
+    auto mgr = this;
+    for (const auto &key : r.keys) {
+      auto it = mgr->signalsMap_.find(key);
+      if (it == mgr->signalsMap_.end()) {
+        break;
+      }
+      r.chain.push_back(&it->second);
+      if (!(mgr = it->second.child_.get())) {
+        break;
+      }
+    }
+  }
+
+  template <class Write>
+  void onChanged(NodeType &root, const std::vector<const PathType *> &paths,
+                 Write &&write, DiffContextType &ctx) {
+    auto routes = std::vector<Route>{};
+    routes.reserve(paths.size());
+    auto routePtrs = std::vector<const Route *>{};
+    routePtrs.reserve(paths.size());
+    for (auto path : paths) {
+      routePtrs.push_back(&routes.emplace_back(route(*path)));
+    }
+    onChanged(root, std::move(routePtrs), std::forward<Write>(write), ctx);
+  }
+
+  // Incremental notification for replacing the subtrees at `routes`, which
+  // `write` does on `root`: subscriptions below a route are diffed against its
+  // old subtree only, subscriptions above it are notified once if anything
+  // below them changed. A route nested in another one is covered by the outer
+  // route's diff.
+  template <class Write>
+  void onChanged(NodeType &root, std::vector<const Route *> routes,
+                 Write &&write, DiffContextType &ctx) {
+    if (routes.size() > 1) {
+      dropCoveredRoutes(routes);
+    }
+    // The empty path covers the whole tree, diffed like a root update
+    if (!routes.empty() && routes.front()->keys.empty()) {
+      auto oldRoot = root;
+      write();
+      onChanged(oldRoot, root, ctx);
+      return;
+    }
+
+    auto targets = std::vector<Target>{};
+    targets.reserve(routes.size());
+    auto ancestors = std::vector<Ancestor>{};
+    auto ancestorIndexes = std::unordered_map<const void *, size_t>{};
+    auto matches = std::vector<WildcardMatch>{};
+    for (auto r : routes) {
+      if constexpr (HasWildcards) {
+        addWildcardMatches(root, *r, routes.size() > 1, matches);
+      }
+      if (r->chain.empty()) {
+        continue;
+      }
+      auto &target = targets.emplace_back();
+      target.route = r;
+      auto nodes = nodesAt(root, r->keys, r->keys.size());
+      auto depths = std::min(r->chain.size(), r->keys.size() - 1);
+      for (size_t depth = 0; depth < depths; ++depth) {
+        auto entry = r->chain[depth];
+        if (entry->signalPtr_) {
+          auto index = ancestors.size();
+          if (routes.size() > 1) {
+            index = ancestorIndexes.emplace(entry, index).first->second;
+          }
+          if (index == ancestors.size()) {
+            ancestors.push_back({entry, r, depth, *nodes[depth]});
+          }
+          target.ancestors.push_back(index);
+        }
+      }
+      target.oldNode = *nodes.back();
+    }
+
+    write();
+
+    for (auto &target : targets) {
+      const auto &r = *target.route;
+      auto newNodes = nodesAt(root, r.keys, r.keys.size());
+      const auto &newValue = *newNodes.back();
+      auto changed = false;
+      if (r.chain.size() == r.keys.size()) {
+        auto &[modSignal, sub, version] = *r.chain.back();
+        if (sub) {
+          atKeys(ctx, r.keys, r.keys.size(), [&] {
+            changed = sub->onChanged(target.oldNode, newValue, ctx);
+          });
+        }
+        changed = changed || ctx.changed(target.oldNode, newValue);
+        if (changed && modSignal) {
+          version = ctx.version();
+          ctx.changedAt(modSignal, target.oldNode, newValue);
+        }
+      } else {
+        changed = ctx.changed(target.oldNode, newValue);
+      }
+      if (changed) {
+        for (auto index : target.ancestors) {
+          ancestors[index].changed = true;
+        }
+      } else if (TraitType::empty(target.oldNode)) {
+        // A write below a missing or scalar node can replace its ancestors
+        // even if the written node is empty, e.g. a null below a scalar
+        for (auto index : target.ancestors) {
+          ancestors[index].compare = true;
+        }
+      }
+    }
+
+    if constexpr (HasWildcards) {
+      for (auto &match : matches) {
+        const auto &keys = match.route->keys;
+        auto newNodes = nodesAt(root, keys, match.depth + 1);
+        atKeys(ctx, keys, match.depth, [&] {
+          matchChild(*match.entry, match.kind, keys[match.depth],
+                     match.oldNode, *newNodes.back(), ctx);
+        });
+      }
+    }
+
+    std::stable_sort(ancestors.begin(), ancestors.end(),
+                     [](const Ancestor &a1, const Ancestor &a2) {
+                       return a1.depth > a2.depth;
+                     });
+    for (const auto &ancestor : ancestors) {
+      if (ancestor.changed || ancestor.compare) {
+        auto newNodes = nodesAt(root, ancestor.route->keys, ancestor.depth + 1);
+        const auto &newNode = *newNodes.back();
+        if (ancestor.changed || ctx.changed(ancestor.oldNode, newNode)) {
+          ancestor.entry->version_ = ctx.version();
+          ctx.changedAt(ancestor.entry->signalPtr_, ancestor.oldNode, newNode);
+        }
+      }
+    }
   }
 
  private:
+  // The version is the tree version of the last write that changed the node
+  // while the entry had a signal, or of the creation of the signal
   struct MySignalAndChild {
     SignalPtrType signalPtr_;
-    std::unique_ptr<SignalMgr> child_;
+    typename LevelsType::Ptr child_;
+    std::uint64_t version_ = 0;
+  };
+
+  static std::uint64_t version(const MySignalAndChild &entry,
+                               std::uint64_t treeVersion) {
+    return entry.signalPtr_ ? entry.version_ : treeVersion;
+  }
+
+  using IndexType =
+      typename Tree::IndexType::template Type<KeyType, MySignalAndChild>;
+  using IndexIterator = typename IndexType::iterator;
+
+  struct Target {
+    const Route *route = nullptr;
+    std::vector<size_t> ancestors;
+    NodeType oldNode = {};
+  };
+
+  struct Ancestor {
+    MySignalAndChild *entry;
+    const Route *route;
+    size_t depth;
+    NodeType oldNode;
+    bool changed = false;
+    // compared after the write, the node below it being empty before
+    bool compare = false;
+  };
+
+  enum class Walk : char { Keys, Merge, Children };
+
+  // Looks up the observed keys in the nodes, walks the children of the nodes
+  // and looks them up in the index, or merges both sorted sequences, whatever
+  // touches fewer elements. Without child counts the merge is used if the
+  // children are sorted.
+  Walk walkFor(const NodeType &oldNode, const NodeType &newNode) const {
+    constexpr auto Sorted = detail::sortedChildren<TraitType>();
+    if constexpr (detail::HasSize<TraitType, NodeType>::value) {
+      auto children = TraitType::size(oldNode) + TraitType::size(newNode);
+      auto observed = signalsMap_.size();
+      if (children < observed / 4) {
+        return Walk::Children;
+      }
+      if (observed < children / 4) {
+        return Walk::Keys;
+      }
+      if (Sorted) {
+        return Walk::Merge;
+      }
+      return children < observed ? Walk::Children : Walk::Keys;
+    } else {
+      return Sorted ? Walk::Merge : Walk::Keys;
+    }
+  }
+
+  // Diffs the level by the walk touching fewer elements, see walkFor()
+  bool onChangedByWalk(const NodeType &oldNode, const NodeType &newNode,
+                       DiffContextType &ctx) {
+    auto walk = Walk::Keys;
+    if constexpr (CanWalkChildren) {
+      walk = walkFor(oldNode, newNode);
+    }
+    if (walk != Walk::Children && ctx.parallel() &&
+        signalsMap_.size() >= ctx.parallel()->minEntries) {
+      return onChangedInParallel(oldNode, newNode, ctx);
+    }
+    if constexpr (CanWalkChildren) {
+      switch (walk) {
+        case Walk::Children:
+          return onChangedByChildren(oldNode, newNode, ctx);
+        case Walk::Merge:
+          return onChangedByMerge(oldNode, newNode, ctx);
+        case Walk::Keys:
+          break;
+      }
+    }
+    return onChangedByKeys(oldNode, newNode, ctx);
+  }
+
+  bool onChangedByKeys(const NodeType &oldNode, const NodeType &newNode,
+                       DiffContextType &ctx) {
+    bool hasChanged = false;
+    for (auto it = signalsMap_.begin(); it != signalsMap_.end();) {
+      auto oldChild = ChildRefType{oldNode, it->first};
+      auto newChild = ChildRefType{newNode, it->first};
+      hasChanged |= onChanged(it, oldNode, newNode, *oldChild, *newChild, ctx);
+      it = releaseUnused(it, ctx.pruned());
+    }
+    return hasChanged;
+  }
+
+  struct DiffTask {
+    IndexIterator first;
+    IndexIterator last;
+    typename Tree::InstrumentationType instrumentation;
+    typename DiffContextType::CollectedList notifications;
+    ChangeSet<Tree> changes;
+    PruneCounts pruned;
+    bool changed = false;
+    std::exception_ptr error;
+  };
+
+  // Looks up the observed keys like onChangedByKeys, ranges of them in tasks
+  // with contexts of their own. Their levels below are diffed serially.
+  bool onChangedInParallel(const NodeType &oldNode, const NodeType &newNode,
+                           DiffContextType &ctx) {
+    const auto &parallel = *ctx.parallel();
+    auto entries = signalsMap_.size();
+    auto tasks = std::vector<DiffTask>(
+        std::min(entries, std::max<size_t>((parallel.workers + 1) * 4, 1)));
+    auto it = signalsMap_.begin();
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      tasks[i].first = it;
+      std::advance(it, entries / tasks.size() + (i < entries % tasks.size()));
+      tasks[i].last = it;
+    }
+    auto run = [&](size_t index) {
+      auto &task = tasks[index];
+      try {
+        auto taskCtx =
+            ctx.fork(task.instrumentation, task.notifications, task.changes);
+        for (auto entry = task.first; entry != task.last; ++entry) {
+          auto oldChild = ChildRefType{oldNode, entry->first};
+          auto newChild = ChildRefType{newNode, entry->first};
+          task.changed |= onChanged(entry, oldNode, newNode, *oldChild,
+                                    *newChild, taskCtx);
+        }
+        task.pruned = taskCtx.pruned();
+      } catch (...) {
+        task.error = std::current_exception();
+      }
+    };
+    detail::runTasks(parallel.executor, parallel.workers, tasks.size(), run);
+    for (const auto &task : tasks) {
+      if (task.error) {
+        std::rethrow_exception(task.error);
+      }
+    }
+    for (auto entry = signalsMap_.begin(); entry != signalsMap_.end();) {
+      entry = releaseUnused(entry, ctx.pruned());
+    }
+    bool hasChanged = false;
+    for (auto &task : tasks) {
+      ctx.join(task.instrumentation, task.notifications, task.changes,
+               task.pruned);
+      hasChanged |= task.changed;
+    }
+    return hasChanged;
+  }
+
+  // Requires the index and the children to be in the same order
+  bool onChangedByMerge(const NodeType &oldNode, const NodeType &newNode,
+                        DiffContextType &ctx) {
+    auto &oldChildren = ctx.acquireChildren();
+    auto &newChildren = ctx.acquireChildren();
+    auto collect = [](auto &children) {
+      return [&children](const KeyType &key, const NodeType &child) {
+        children.emplace_back(&key, &child);
+      };
+    };
+    TraitType::forEachChild(oldNode, collect(oldChildren));
+    TraitType::forEachChild(newNode, collect(newChildren));
+    auto childAt = [](const auto &children, auto &pos, const KeyType &key) {
+      while (pos != children.end() && *pos->first < key) {
+        ++pos;
+      }
+      return pos != children.end() && !(key < *pos->first)
+                 ? pos->second
+                 : &detail::emptyNode<NodeType>();
+    };
+    bool hasChanged = false;
+    auto oldPos = oldChildren.cbegin();
+    auto newPos = newChildren.cbegin();
+    for (auto it = signalsMap_.begin(); it != signalsMap_.end();) {
+      const auto &oldChild = *childAt(oldChildren, oldPos, it->first);
+      const auto &newChild = *childAt(newChildren, newPos, it->first);
+      hasChanged |= onChanged(it, oldNode, newNode, oldChild, newChild, ctx);
+      it = releaseUnused(it, ctx.pruned());
+    }
+    ctx.releaseChildren(2);
+    return hasChanged;
+  }
+
+  // Observed keys missing in both nodes are skipped, they are pruned by
+  // later walks or by prune(). When the level records all changes, the
+  // children that are not observed are recorded.
+  bool onChangedByChildren(const NodeType &oldNode, const NodeType &newNode,
+                           DiffContextType &ctx) {
+    bool hasChanged = false;
+    auto recordsAll = ctx.recordsAll();
+    if constexpr (HasWildcards) {
+      if (hasWildcards_) {
+        // the matched children are recorded by the walk below
+        if (recordsAll) {
+          ctx.pauseRecording(true);
+        }
+        for (auto kind : {detail::Wildcard::Child, detail::Wildcard::Subtree}) {
+          auto it = signalsMap_.find(detail::wildcardKey<KeyType>(kind));
+          if (it != signalsMap_.end()) {
+            hasChanged |=
+                matchChildren(it->second, kind, oldNode, newNode, ctx);
+            releaseUnused(it, ctx.pruned());
+          }
+        }
+        if (recordsAll) {
+          ctx.pauseRecording(false);
+        }
+      }
+    }
+    auto record = [&](const KeyType &key, const NodeType &oldChild,
+                      const NodeType &newChild) {
+      ctx.pushKey(key);
+      hasChanged |= ctx.recordBelow(oldChild, newChild);
+      ctx.popKey();
+    };
+    auto visit = [&](const KeyType &key, const NodeType &oldChild,
+                     const NodeType &newChild) {
+      if constexpr (HasWildcards) {
+        if (hasWildcards_ &&
+            detail::wildcard(key) != detail::Wildcard::None) {
+          if (recordsAll) {
+            record(key, oldChild, newChild);
+          }
+          return;
+        }
+      }
+      if (auto it = signalsMap_.find(key); it != signalsMap_.end()) {
+        hasChanged |= onChanged(it->second, it->first, oldChild, newChild, ctx);
+        releaseUnused(it, ctx.pruned());
+      } else if (recordsAll) {
+        record(key, oldChild, newChild);
+      }
+    };
+    // Only the child found by getChild is diffed when keys are repeated
+    TraitType::forEachChild(
+        oldNode, [&](const KeyType &key, const NodeType &oldChild) {
+          if (TraitType::getChild(oldNode, key) == &oldChild) {
+            auto newChild = ChildRefType{newNode, key};
+            visit(key, oldChild, *newChild);
+          }
+        });
+    TraitType::forEachChild(
+        newNode, [&](const KeyType &key, const NodeType &newChild) {
+          if (!TraitType::getChild(oldNode, key) &&
+              TraitType::getChild(newNode, key) == &newChild) {
+            visit(key, detail::emptyNode<NodeType>(), newChild);
+          }
+        });
+    return hasChanged;
+  }
+
+  // Diffs the entry at `it` of the index of a level whose old and new nodes
+  // are given, a wildcard matches the children of the nodes
+  bool onChanged(IndexIterator it, const NodeType &oldNode,
+                 const NodeType &newNode, const NodeType &oldChild,
+                 const NodeType &newChild, DiffContextType &ctx) {
+    if constexpr (HasWildcards) {
+      if (auto kind = detail::wildcard(it->first);
+          kind != detail::Wildcard::None) {
+        return matchChildren(it->second, kind, oldNode, newNode, ctx);
+      }
+    }
+    return onChanged(it->second, it->first, oldChild, newChild, ctx);
+  }
+
+  bool onChanged(MySignalAndChild &entry, const KeyType &key,
+                 const NodeType &oldValue, const NodeType &newValue,
+                 DiffContextType &ctx) {
+    auto recordsAll = ctx.recordsAll();
+    auto tracksKeys = HasWildcards || ctx.recordsObserved() || recordsAll;
+    if (tracksKeys) {
+      ctx.pushKey(key);
+    }
+    auto changed = false;
+    auto &[modSignal, sub, version] = entry;
+    if (recordsAll) {
+      changed = sub ? ctx.recordAt(oldValue, newValue,
+                                   [&] {
+                                     return sub->onChanged(oldValue, newValue,
+                                                           ctx);
+                                   })
+                    : ctx.recordBelow(oldValue, newValue);
+    } else if (sub && sub->onChanged(oldValue, newValue, ctx)) {
+      // if sub value changed then current one must be changed
+      // don't need to waste time comparing
+      changed = true;
+    } else {
+      changed = ctx.changed(oldValue, newValue);
+    }
+    if (changed && modSignal) {
+      version = ctx.version();
+      ctx.changedAt(modSignal, oldValue, newValue);
+    }
+    if (tracksKeys) {
+      ctx.popKey();
+    }
+    return changed;
+  }
+
+  // Wildcard entry at `depth` of a route, matching the route's key there
+  struct WildcardMatch {
+    MySignalAndChild *entry;
+    detail::Wildcard kind;
+    const Route *route;
+    size_t depth;
+    NodeType oldNode;
   };
 
+  void addWildcardMatches(const NodeType &root, const Route &r, bool dedupe,
+                          std::vector<WildcardMatch> &matches) {
+    auto mgr = this;
+    for (size_t depth = 0; mgr && depth < r.keys.size(); ++depth) {
+      if (mgr->hasWildcards_) {
+        for (auto kind : {detail::Wildcard::Child, detail::Wildcard::Subtree}) {
+          auto it = mgr->signalsMap_.find(detail::wildcardKey<KeyType>(kind));
+          if (it == mgr->signalsMap_.end()) {
+            continue;
+          }
+          auto isSame = [&](const WildcardMatch &match) {
+            return match.entry == &it->second &&
+                   match.route->keys[depth] == r.keys[depth];
+          };
+          if (dedupe && std::any_of(matches.begin(), matches.end(), isSame)) {
+            continue;
+          }
+          auto nodes = nodesAt(root, r.keys, depth + 1);
+          matches.push_back({&it->second, kind, &r, depth, *nodes.back()});
+        }
+      }
+      mgr = depth < r.chain.size() ? r.chain[depth]->child_.get() : nullptr;
+    }
+  }
+
+  // Matches a wildcard entry against the children present in either node,
+  // "**" against their descendants too. Returns true if a child changed.
+  bool matchChildren(MySignalAndChild &entry, detail::Wildcard kind,
+                     const NodeType &oldNode, const NodeType &newNode,
+                     DiffContextType &ctx) {
+    if (detail::identical<TraitType>(oldNode, newNode)) {
+      return false;
+    }
+    auto changed = false;
+    // Only the child found by getChild is matched, which skips repeated keys
+    // and the children getChild hides, e.g. nulls, matched as new children
+    TraitType::forEachChild(
+        oldNode, [&](const KeyType &key, const NodeType &oldChild) {
+          if (TraitType::getChild(oldNode, key) == &oldChild) {
+            auto newChild = ChildRefType{newNode, key};
+            changed |= matchChild(entry, kind, key, oldChild, *newChild, ctx);
+          }
+        });
+    TraitType::forEachChild(
+        newNode, [&](const KeyType &key, const NodeType &newChild) {
+          if (!TraitType::getChild(oldNode, key) &&
+              TraitType::getChild(newNode, key) == &newChild) {
+            changed |= matchChild(entry, kind, key,
+                                  detail::emptyNode<NodeType>(), newChild, ctx);
+          }
+        });
+    return changed;
+  }
+
+  bool matchChild(MySignalAndChild &entry, detail::Wildcard kind,
+                  const KeyType &key, const NodeType &oldChild,
+                  const NodeType &newChild, DiffContextType &ctx) {
+    if (!ctx.changed(oldChild, newChild)) {
+      return false;
+    }
+    ctx.pushKey(key);
+    ctx.beginMatch();
+    auto &[modSignal, sub, version] = entry;
+    if (sub) {
+      sub->onChanged(oldChild, newChild, ctx);
+    }
+    if (kind == detail::Wildcard::Subtree) {
+      matchChildren(entry, kind, oldChild, newChild, ctx);
+    }
+    if (modSignal) {
+      version = ctx.version();
+      ctx.changedAt(modSignal, oldChild, newChild);
+    }
+    ctx.endMatch();
+    ctx.popKey();
+    return true;
+  }
+
+  // Releases the entry's signal when nobody can connect to it anymore and its
+  // child level when it is empty, then erases the entry if both are gone.
+  // Returns the iterator to the next entry.
+  IndexIterator releaseUnused(IndexIterator it, PruneCounts &counts) {
+    auto &[modSignal, sub, version] = it->second;
+    if (modSignal && modSignal.use_count() == 1 && !modSignal->connected()) {
+      modSignal.reset();
+      ++counts.signals;
+    }
+    if (sub && sub->signalsMap_.empty()) {
+      sub.reset();
+    }
+    if (!modSignal && !sub) {
+      ++counts.entries;
+      return signalsMap_.erase(it);
+    }
+    return ++it;
+  }
+
+  // Keeps one route per path, and none below another route's path
+  static void dropCoveredRoutes(std::vector<const Route *> &routes) {
+    std::sort(routes.begin(), routes.end(),
+              [](const Route *r1, const Route *r2) {
+                return r1->keys < r2->keys;
+              });
+    auto isPrefix = [](const KeyList &prefix, const KeyList &keys) {
+      return prefix.size() <= keys.size() &&
+             std::equal(prefix.begin(), prefix.end(), keys.begin());
+    };
+    auto last = routes.begin();
+    for (auto it = std::next(last); it != routes.end(); ++it) {
+      if (!isPrefix((*last)->keys, (*it)->keys)) {
+        *++last = *it;
+      }
+    }
+    routes.erase(std::next(last), routes.end());
+  }
+
+  // Runs `fn` with the first `depth` keys on the context's key stack
+  template <class Fn>
+  static void atKeys(DiffContextType &ctx, const KeyList &keys, size_t depth,
+                     Fn &&fn) {
+    if constexpr (HasWildcards) {
+      for (size_t i = 0; i < depth; ++i) {
+        ctx.pushKey(keys[i]);
+      }
+      fn();
+      for (size_t i = 0; i < depth; ++i) {
+        ctx.popKey();
+      }
+    } else {
+      fn();
+    }
+  }
+
+  // Nodes along the first `depth` keys, the last one is the node at that depth
+  static std::vector<ChildRefType> nodesAt(const NodeType &root,
+                                           const KeyList &keys, size_t depth) {
+    auto nodes = std::vector<ChildRefType>{};
+    nodes.reserve(depth);
+    const NodeType *node = &root;
+    for (size_t i = 0; i < depth; ++i) {
+      node = &*nodes.emplace_back(*node, keys[i]);
+    }
+    return nodes;
+  }
+
   template <class Iterator>
-  SignalPtrType createSignal(Iterator itFirstKey, Iterator itLastKey) {
+  SignalPtrType createSignal(Iterator itFirstKey, Iterator itLastKey,
+                             std::uint64_t version) {
+    if constexpr (HasWildcards) {
+      hasWildcards_ |= detail::wildcard<KeyType>(*itFirstKey) !=
+                       detail::Wildcard::None;
+    }
     auto &subAndSig = signalsMap_[*itFirstKey];
     if (++itFirstKey != itLastKey) {
       if (!subAndSig.child_) {
-        subAndSig.child_ = std::make_unique<SignalMgr>();
+        subAndSig.child_ = levels_->create();
       }
-      return subAndSig.child_->createSignal(itFirstKey, itLastKey);
+      return subAndSig.child_->createSignal(itFirstKey, itLastKey, version);
     } else {
       if (!subAndSig.signalPtr_) {
-        subAndSig.signalPtr_.reset(new SignalType);
+        subAndSig.signalPtr_ = SignalPtrType{new SignalType};
+        subAndSig.version_ = version;
       }
       return subAndSig.signalPtr_;
     }
   }
 
-  SignalPtrType getSignal(const PathType &path) {
-    using std::begin;
-    using std::end;
-    auto ibeg = begin(path);
-    auto iend = end(path);
-    if (ibeg != iend) {
-      if (auto sigNChild = getSigNChild(ibeg, iend)) {
-        return sigNChild->signalPtr_;
-      }
-    }
-    return {};
-  }
-
   template <class KeyItor>
   MySignalAndChild *getSigNChild(KeyItor pathBegin, KeyItor pathEnd) {
     if (auto it = signalsMap_.find(*pathBegin); it != signalsMap_.end()) {
@@ -442,13 +3026,140 @@ class SignalMgr {
     return nullptr;
   }
 
-  std::map<KeyType, MySignalAndChild> signalsMap_;
+  LevelsType *levels_;
+  IndexType signalsMap_;
+  bool hasWildcards_ = false;
+};
+
+// Collects path updates and deletions that are applied by commit() under a
+// single tree lock and notified in one pass. A path written several times is
+// notified once, with its value from before the transaction and its final
+// value. Writes that are not committed are discarded.
+template <class Tree>
+class Transaction {
+  using PathType = typename Tree::PathType;
+  using NodeType = typename Tree::NodeType;
+
+ public:
+  void set(const PathType &path, const NodeType &newNode) {
+    writes_.emplace_back(path, newNode);
+  }
+
+  void set(const PathType &path, NodeType &&newNode) {
+    writes_.emplace_back(path, std::move(newNode));
+  }
+
+  void erase(const PathType &path) {
+    static_assert(
+        detail::HasErase<typename Tree::TraitType, NodeType, PathType>::value,
+        "Erasing paths needs Trait::erase");
+    writes_.emplace_back(path, std::nullopt);
+  }
+
+  void commit() {
+    if (!writes_.empty()) {
+      tree_->commit(std::move(writes_));
+      writes_.clear();
+    }
+  }
+
+ private:
+  friend Tree;
+  Transaction(Tree &tree) : tree_{&tree} {}
+
+  Tree *tree_;
+  // Deletions have no node
+  std::vector<std::pair<PathType, std::optional<NodeType>>> writes_;
+};
+
+// Immutable view of the whole tree at the time it was taken
+template <class Tree>
+class Snapshot {
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using TraitType = typename Tree::TraitType;
+
+ public:
+  Snapshot(std::shared_ptr<const NodeType> root) : root_{std::move(root)} {}
+
+  const NodeType &get() const { return *root_; }
+
+  NodeType get(const PathType &path) const {
+    return TraitType::get(*root_, path);
+  }
+
+  template <typename T>
+  T get(const PathType &path) const {
+    return TraitType::template get<T>(*root_, path);
+  }
+
+ private:
+  std::shared_ptr<const NodeType> root_;
+};
+
+// Awaitable changes of one subscription path, defined in otree/ChangeStream.h
+// which needs C++20
+template <class Tree>
+class ChangeStream;
+
+// Scoped read access to the live nodes of a tree, without copies. It holds the
+// tree lock until destroyed, so an update on the same thread meanwhile
+// deadlocks.
+template <class Tree>
+class ReadView {
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using TraitType = typename Tree::TraitType;
+  using KeyType = typename Tree::KeyType;
+
+ public:
+  const NodeType &get() const { return tree_->root_; }
+
+  const NodeType &get(const PathType &path) const {
+    static_assert(detail::HasGetChild<TraitType, NodeType, KeyType>::value,
+                  "Reading paths without copies needs Trait::getChild");
+    return detail::nodeAt<TraitType, NodeType, KeyType>(tree_->root_, path);
+  }
+
+ private:
+  friend Tree;
+  explicit ReadView(const Tree &tree) : tree_{&tree}, lock_{tree.mutex_} {}
+
+  const Tree *tree_;
+  std::unique_lock<typename Tree::MutexType> lock_;
+};
+
+// Path resolved once by ObservableTree::resolve, caching the parsed keys, the
+// subscription entries along the path and, if the trait can locate nodes, the
+// node itself. The caches are revalidated by the tree under its lock whenever
+// subscriptions or the nodes have changed since they were filled.
+template <class Tree>
+class PathHandle {
+  using PathType = typename Tree::PathType;
+  using NodeType = typename Tree::NodeType;
+  using RouteType = typename SignalMgr<Tree>::Route;
+
+ public:
+  const PathType &path() const { return path_; }
+
+ private:
+  friend Tree;
+  PathHandle(const PathType &path, RouteType &&route, size_t routeEpoch)
+      : path_{path}, route_{std::move(route)}, routeEpoch_{routeEpoch} {}
+
+  PathType path_;
+  RouteType route_;
+  size_t routeEpoch_;
+  NodeType *node_ = nullptr;
+  size_t nodeEpoch_ = 0;
 };
 
 template <class Node, class Trait, class Path = otree::Path,
-          class Key = otree::Path::KeyType, class Mutex = NoEffectMutex>
+          class Key = otree::Path::KeyType, class Mutex = NoEffectMutex,
+          class Index = MapIndex, class Instrumentation = NoInstrumentation>
 class ObservableTree {
-  using MyType = ObservableTree<Node, Trait, Path, Key, Mutex>;
+  using MyType =
+      ObservableTree<Node, Trait, Path, Key, Mutex, Index, Instrumentation>;
 
  public:
   using NodeType = Node;
@@ -456,36 +3167,283 @@ class ObservableTree {
   using PathType = Path;
   using KeyType = Key;
   using MutexType = Mutex;
+  using IndexType = Index;
+  using InstrumentationType = Instrumentation;
   using SignalPtrType = typename SignalMgr<MyType>::SignalPtrType;
 
   SignalPtrType modificationSignal(const PathType &path) {
     LockGuard lock(mutex_);
-    return signalMgr_.createSignal(path);
+    ++routeEpoch_;
+    return signalMgr_.createSignal(path, version_);
   }
 
-  void set(NodeType &&newData) {
+  // Connects the slot of each {path, slot} of `subscriptions` like
+  // modificationSignal(path)->connect(slot), with one tree lock for all the
+  // paths. A path shares the index lookups of the keys it has in common with
+  // the previous one, and a signal getting several slots in a row moves to a
+  // slot table once. Returns the connections in the order of the
+  // subscriptions. Paths must not be empty.
+  template <class Subscriptions>
+  auto subscribeMany(Subscriptions &&subscriptions) {
+    using ConnectionType =
+        decltype(std::declval<SignalPtrType &>()->connect(nullptr));
+    auto paths = std::vector<const PathType *>{};
+    auto converted = std::deque<PathType>{};
+    for (const auto &[path, slot] : subscriptions) {
+      if constexpr (std::is_same_v<std::decay_t<decltype(path)>, PathType>) {
+        paths.push_back(&path);
+      } else {
+        paths.push_back(&converted.emplace_back(path));
+      }
+    }
+    auto signals = std::vector<SignalPtrType>{};
+    signals.reserve(paths.size());
+    {
+      LockGuard lock(mutex_);
+      ++routeEpoch_;
+      signalMgr_.createSignals(paths, version_, signals);
+    }
+    for (auto run = signals.begin(); run != signals.end();) {
+      auto next = std::find_if(run, signals.end(), [&](const auto &signal) {
+        return signal != *run;
+      });
+      if (next - run > 1) {
+        (*run)->reserve(static_cast<size_t>(next - run));
+      }
+      run = next;
+    }
+    auto connections = std::vector<ConnectionType>{};
+    connections.reserve(paths.size());
+    auto i = size_t{0};
+    for (auto &&[path, slot] : subscriptions) {
+      if constexpr (std::is_lvalue_reference_v<Subscriptions>) {
+        connections.push_back(signals[i++]->connect(slot));
+      } else {
+        connections.push_back(signals[i++]->connect(std::move(slot)));
+      }
+    }
+    return connections;
+  }
+
+  // Disconnects all of `connections` and prunes the index once, instead of
+  // leaving their subscriptions to the diffs that visit them
+  template <class Connections>
+  PruneCounts disconnectMany(Connections &connections) {
+    for (auto &connection : connections) {
+      connection.disconnect();
+    }
+    return prune();
+  }
+
+  // ChangeStream of path, with StreamOptions if given
+  template <class... Options>
+  auto changes(const PathType &path, Options &&... options) {
+    return ChangeStream<MyType>{modificationSignal(path),
+                                std::forward<Options>(options)...};
+  }
+
+  PathHandle<MyType> resolve(const PathType &path) {
     LockGuard lock(mutex_);
-    signalMgr_.onChanged(root_, newData);
-    root_ = std::move(newData);
+    return {path, signalMgr_.route(path), routeEpoch_};
   }
 
-  void set(const NodeType &newData) {
+  // Incremented by every write, before its diff
+  std::uint64_t version() const {
+    return version_.load(std::memory_order_acquire);
+  }
+
+  // Tree version of the last write that changed the node at `path` since the
+  // path has a signal, or of the creation of the signal. Paths without one
+  // have the tree version. Either way it never decreases and moves whenever
+  // the node changes, a poller reads the node only then. Holding the signal
+  // keeps it from being pruned.
+  std::uint64_t version(const PathType &path) {
+    LockGuard lock(mutex_);
+    return signalMgr_.version(path, version());
+  }
+
+  // Same without parsing and looking up the path while the subscriptions
+  // along it are unchanged
+  std::uint64_t version(PathHandle<MyType> &handle) {
+    LockGuard lock(mutex_);
+    if (handle.routeEpoch_ != routeEpoch_) {
+      signalMgr_.refresh(handle.route_);
+      handle.routeEpoch_ = routeEpoch_;
+    }
+    return SignalMgr<MyType>::version(handle.route_, version());
+  }
+
+  // In Deferred mode slots run after the tree lock has been released, on the
+  // executor if one is given, otherwise on the thread that updated the tree
+  void setDispatchMode(DispatchMode mode, Executor executor = {}) {
     LockGuard lock(mutex_);
-    signalMgr_.onChanged(root_, newData);
-    root_ = newData;
+    dispatchMode_ = mode;
+    notificationQueue_->setExecutor(std::move(executor));
+  }
+
+  // Diffs large subscription levels in parallel, none without an executor
+  void setParallelDiff(ParallelDiff parallel) {
+    LockGuard lock(mutex_);
+    parallelDiff_ = std::move(parallel);
+  }
+
+  void set(NodeType &&newData) {
+    update([&](DiffContext<MyType> &ctx) {
+      signalMgr_.onChanged(root_, newData, ctx);
+      root_ = std::move(newData);
+    });
+  }
+
+  void set(const NodeType &newData) {
+    update([&](DiffContext<MyType> &ctx) {
+      signalMgr_.onChanged(root_, newData, ctx);
+      root_ = newData;
+    });
+  }
+
+  // Also appends the changes in `scope` to `changes`, computed by the same
+  // diff pass that notifies, observed changes in notification order
+  void set(NodeType &&newData, ChangeSet<MyType> &changes,
+           ChangeScope scope = ChangeScope::Observed) {
+    static_assert(detail::canMakePath<TraitType, PathType, KeyType>(),
+                  "Change sets need paths constructible from their keys");
+    update([&](DiffContext<MyType> &ctx) {
+      ctx.recordChanges(&changes, scope);
+      if (ctx.recordsAll()) {
+        ctx.recordAt(root_, newData,
+                     [&] { return signalMgr_.onChanged(root_, newData, ctx); });
+      } else {
+        signalMgr_.onChanged(root_, newData, ctx);
+      }
+      root_ = std::move(newData);
+    });
+  }
+
+  void set(const NodeType &newData, ChangeSet<MyType> &changes,
+           ChangeScope scope = ChangeScope::Observed) {
+    set(NodeType{newData}, changes, scope);
   }
 
   // tbd: set(data, path)
+  // Notifies the subscriptions at, below and above `path`
   void set(const PathType &path, const NodeType &newNode) {
-    LockGuard lock(mutex_);
-    signalMgr_.onChanged(path, TraitType::get(root_, path), newNode);
-    TraitType::set(root_, path, newNode);
+    update([&](DiffContext<MyType> &ctx) {
+      signalMgr_.onChanged(
+          root_, {&path}, [&] { TraitType::set(root_, path, newNode); }, ctx);
+    });
   }
 
   void set(const PathType &path, NodeType &&newNode) {
+    update([&](DiffContext<MyType> &ctx) {
+      signalMgr_.onChanged(
+          root_, {&path},
+          [&] { TraitType::set(root_, path, std::move(newNode)); }, ctx);
+    });
+  }
+
+  // Applies a merge patch in the style of RFC 7386: objects of the patch are
+  // merged into the objects of the tree, empty nodes, e.g. json null, delete
+  // and other nodes replace. Only the paths the patch writes or deletes, and
+  // the subscriptions at, below and above them, are diffed, like in commit(),
+  // notifying the same subscriptions with the same nodes as set() of the
+  // patched root. A patch or a root that is not an object replaces the root.
+  void merge(const NodeType &patch) {
+    static_assert(
+        detail::HasForEachChild<TraitType, NodeType, KeyType>::value &&
+            detail::HasGetChild<TraitType, NodeType, KeyType>::value &&
+            detail::HasErase<TraitType, NodeType, PathType>::value,
+        "Merge patches need Trait::forEachChild, getChild and erase");
+    static_assert(detail::canMakePath<TraitType, PathType, KeyType>(),
+                  "Merge patches need paths constructible from their keys");
+    update([&](DiffContext<MyType> &ctx) {
+      if (!isObject(patch) || !isObject(root_)) {
+        auto newRoot = isObject(patch) ? merged(patch) : patch;
+        signalMgr_.onChanged(root_, newRoot, ctx);
+        root_ = std::move(newRoot);
+        return;
+      }
+      auto writes = WriteList{};
+      auto keys = std::vector<const KeyType *>{};
+      collectPatch(root_, patch, keys, writes);
+      auto paths = std::vector<const PathType *>{};
+      paths.reserve(writes.size());
+      for (const auto &write : writes) {
+        paths.push_back(&write.first);
+      }
+      signalMgr_.onChanged(root_, paths, [&] { apply(writes); }, ctx);
+    });
+  }
+
+  void set(PathHandle<MyType> &handle, const NodeType &newNode) {
+    assignAt(handle, [&](NodeType &node) { node = newNode; });
+  }
+
+  void set(PathHandle<MyType> &handle, NodeType &&newNode) {
+    assignAt(handle, [&](NodeType &node) { node = std::move(newNode); });
+  }
+
+  NodeType get(PathHandle<MyType> &handle) {
+    LockGuard lock(mutex_);
+    if (auto node = locate(handle)) {
+      return *node;
+    }
+    return TraitType::get(root_, handle.path_);
+  }
+
+  Transaction<MyType> begin() { return {*this}; }
+
+  // Subscriptions of dropped connections are released while the subtrees they
+  // observe are diffed. prune() releases all of them at once.
+  PruneCounts prune() {
+    LockGuard lock(mutex_);
+    auto counts = PruneCounts{};
+    signalMgr_.prune(counts);
+    countPruned(counts);
+    return counts;
+  }
+
+  // Totals of everything pruned since construction
+  PruneCounts pruneCounts() const {
+    LockGuard lock(mutex_);
+    return pruneCounts_;
+  }
+
+  // Counters of the instrumentation policy, e.g. TreeStats
+  auto stats() const {
+    LockGuard lock(mutex_);
+    return instrumentation_.stats();
+  }
+
+  // With snapshots enabled snapshot() returns the published root without
+  // locking or copying. Node types whose trait has the `identical` hook share
+  // their payload, e.g. json11 or Node: each update publishes the new root, a
+  // pointer copy. Other node types, e.g. ptree, would be deep copied: updates
+  // only drop the published root, and the first snapshot() after an update
+  // copies it under the tree lock and publishes it for the next ones.
+  void enableSnapshots(bool enabled = true) {
     LockGuard lock(mutex_);
-    signalMgr_.onChanged(path, TraitType::get(root_, path), newNode);
-    TraitType::set(root_, path, std::move(newNode));
+    snapshotsEnabled_ = enabled;
+    if (enabled) {
+      publishSnapshot();
+    } else {
+      std::atomic_store(&snapshot_, std::shared_ptr<const NodeType>{});
+    }
+  }
+
+  Snapshot<MyType> snapshot() const {
+    if (auto root = std::atomic_load(&snapshot_)) {
+      return {std::move(root)};
+    }
+    LockGuard lock(mutex_);
+    // another reader may have published it meanwhile
+    if (auto root = std::atomic_load(&snapshot_)) {
+      return {std::move(root)};
+    }
+    auto root = std::make_shared<const NodeType>(root_);
+    if (snapshotsEnabled_) {
+      std::atomic_store(&snapshot_, root);
+    }
+    return {std::move(root)};
   }
 
   NodeType get() const {
@@ -493,9 +3451,31 @@ class ObservableTree {
     return root_;
   }
 
+  // Calls `fn(const NodeType &)` with the live root under the tree lock and
+  // returns its result, which must not refer to the node
+  template <class Fn>
+  decltype(auto) visit(Fn &&fn) const {
+    LockGuard lock(mutex_);
+    return fn(static_cast<const NodeType &>(root_));
+  }
+
+  // Same with the node at `path`, empty if missing. Without Trait::getChild
+  // the node is a copy.
+  template <class Fn>
+  decltype(auto) visit(const PathType &path, Fn &&fn) const {
+    LockGuard lock(mutex_);
+    if constexpr (detail::HasGetChild<TraitType, NodeType, KeyType>::value) {
+      return fn(detail::nodeAt<TraitType, NodeType, KeyType>(root_, path));
+    } else {
+      return fn(static_cast<const NodeType &>(TraitType::get(root_, path)));
+    }
+  }
+
+  ReadView<MyType> read() const { return ReadView<MyType>{*this}; }
+
   NodeType get(const PathType &path) {
     LockGuard lock(mutex_);
-    return Trait::get(path);
+    return Trait::get(root_, path);
   }
 
   template <typename T>
@@ -505,9 +3485,207 @@ class ObservableTree {
   }
 
  private:
-  SignalMgr<MyType> signalMgr_;
+  using NotificationQueueType = NotificationQueue<MyType>;
+
+  // Locks the shards and reads their roots for consistent root reads
+  template <class, class, class, class, class, class, class>
+  friend class ShardedObservableTree;
+
+  template <class Assign>
+  void assignAt(PathHandle<MyType> &handle, Assign &&assign) {
+    update([&](DiffContext<MyType> &ctx) {
+      if (handle.routeEpoch_ != routeEpoch_) {
+        signalMgr_.refresh(handle.route_);
+        handle.routeEpoch_ = routeEpoch_;
+      }
+      auto node = locate(handle);
+      signalMgr_.onChanged(
+          root_, {&handle.route_},
+          [&] {
+            if (node) {
+              assign(*node);
+            } else {
+              auto newNode = NodeType{};
+              assign(newNode);
+              TraitType::set(root_, handle.path_, std::move(newNode));
+            }
+          },
+          ctx);
+      if (node) {
+        // assigning keeps the located node in place, update() is about to
+        // invalidate all other located nodes
+        handle.nodeEpoch_ = nodeEpoch_ + 1;
+      }
+    });
+  }
+
+  NodeType *locate(PathHandle<MyType> &handle) {
+    if constexpr (detail::HasLocate<TraitType, NodeType, PathType>::value) {
+      if (handle.nodeEpoch_ != nodeEpoch_) {
+        handle.node_ = TraitType::locate(root_, handle.path_);
+        handle.nodeEpoch_ = nodeEpoch_;
+      }
+      return handle.node_;
+    } else {
+      return nullptr;
+    }
+  }
+
+  friend class Transaction<MyType>;
+  friend class ReadView<MyType>;
+  // Deletions have no node
+  using WriteList = std::vector<std::pair<PathType, std::optional<NodeType>>>;
+
+  void apply(WriteList &writes) {
+    for (auto &[path, newNode] : writes) {
+      if (newNode) {
+        TraitType::set(root_, path, std::move(*newNode));
+      } else if constexpr (detail::HasErase<TraitType, NodeType,
+                                            PathType>::value) {
+        TraitType::erase(root_, path);
+      }
+    }
+  }
+
+  static bool isObject(const NodeType &node) {
+    return detail::isObject<TraitType, NodeType, KeyType>(node);
+  }
+
+  // Writes and deletions of `patch` merged into `target`, the node at `keys`
+  static void collectPatch(const NodeType &target, const NodeType &patch,
+                           std::vector<const KeyType *> &keys,
+                           WriteList &writes) {
+    TraitType::forEachChild(
+        patch, [&](const KeyType &key, const NodeType &child) {
+          keys.push_back(&key);
+          auto current = TraitType::getChild(target, key);
+          if (TraitType::empty(child)) {
+            if (current) {
+              writes.emplace_back(
+                  detail::makePath<TraitType, PathType>(keys), std::nullopt);
+            }
+          } else if (isObject(child) && current && isObject(*current)) {
+            collectPatch(*current, child, keys, writes);
+          } else {
+            writes.emplace_back(detail::makePath<TraitType, PathType>(keys),
+                                isObject(child) ? merged(child) : child);
+          }
+          keys.pop_back();
+        });
+  }
+
+  // The object a patch object merges into a node that is not an object
+  static NodeType merged(const NodeType &patch) {
+    auto node = patch;
+    TraitType::forEachChild(
+        patch, [&](const KeyType &key, const NodeType &child) {
+          auto path = detail::makePath<TraitType, PathType>(
+              std::vector<const KeyType *>{&key});
+          if (TraitType::empty(child)) {
+            TraitType::erase(node, path);
+          } else if (isObject(child)) {
+            TraitType::set(node, path, merged(child));
+          }
+        });
+    return node;
+  }
+
+  void commit(WriteList &&writes) {
+    update([&](DiffContext<MyType> &ctx) {
+      auto paths = std::vector<const PathType *>{};
+      paths.reserve(writes.size());
+      for (const auto &write : writes) {
+        paths.push_back(&write.first);
+      }
+      signalMgr_.onChanged(root_, paths, [&] { apply(writes); }, ctx);
+    });
+  }
+
+  // Applies a modification under the tree lock, deferred notifications are
+  // queued before unlocking and dispatched after, then the functions slots
+  // posted to detail::AfterUpdate run
+  template <class Modification>
+  void update(Modification &&modify) {
+    auto afterUpdate = detail::AfterUpdate{};
+    auto deferred = NotificationList<MyType>{};
+    auto mustDispatch = false;
+    {
+      LockGuard lock(mutex_);
+      auto locked = typename Instrumentation::Clock::time_point{};
+      if constexpr (Instrumentation::Timed) {
+        locked = Instrumentation::Clock::now();
+      }
+      instrumentation_.onSet();
+      auto ctx = DiffContext<MyType>{
+          instrumentation_,
+          dispatchMode_ == DispatchMode::Deferred ? &deferred : nullptr};
+      if (parallelDiff_.executor) {
+        ctx.diffInParallel(&parallelDiff_);
+      }
+      auto version = version_.load(std::memory_order_relaxed) + 1;
+      version_.store(version, std::memory_order_release);
+      ctx.setVersion(version);
+      modify(ctx);
+      ++nodeEpoch_;
+      countPruned(ctx.pruned());
+      if (snapshotsEnabled_) {
+        if constexpr (detail::HasIdentical<TraitType, NodeType>::value) {
+          publishSnapshot();
+        } else {
+          std::atomic_store(&snapshot_, std::shared_ptr<const NodeType>{});
+        }
+      }
+      mustDispatch = !deferred.empty() &&
+                     notificationQueue_->post(std::move(deferred));
+      if constexpr (Instrumentation::Timed) {
+        instrumentation_.onLocked(Instrumentation::Clock::now() - locked);
+      }
+    }
+    if (mustDispatch) {
+      notificationQueue_->run();
+    }
+  }
+
+  void countPruned(const PruneCounts &counts) {
+    if (counts.entries) {
+      ++routeEpoch_;
+    }
+    pruneCounts_ += counts;
+  }
+
+  void publishSnapshot() {
+    std::atomic_store(&snapshot_, std::make_shared<const NodeType>(root_));
+  }
+
+  // outlives the levels of signalMgr_, and does not move with the tree
+  std::unique_ptr<typename SignalMgr<MyType>::LevelsType> levels_ =
+      std::make_unique<typename SignalMgr<MyType>::LevelsType>();
+  SignalMgr<MyType> signalMgr_{*levels_};
   NodeType root_;
+  // published by snapshot() too, which is const
+  mutable std::shared_ptr<const NodeType> snapshot_;
+  bool snapshotsEnabled_ = false;
+  size_t routeEpoch_ = 0;
+  size_t nodeEpoch_ = 1;
+  std::atomic<std::uint64_t> version_{0};
+  PruneCounts pruneCounts_;
+  Instrumentation instrumentation_;
+  DispatchMode dispatchMode_ = DispatchMode::Immediate;
+  ParallelDiff parallelDiff_;
+  std::shared_ptr<NotificationQueueType> notificationQueue_ =
+      std::make_shared<NotificationQueueType>();
   mutable Mutex mutex_;
 };
 
 }  // namespace otree
+
+namespace std {
+
+template <std::size_t N>
+struct hash<otree::StaticPath<N>> {
+  size_t operator()(const otree::StaticPath<N> &path) const {
+    return static_cast<size_t>(path.hash());
+  }
+};
+
+}  // namespace std
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace otree {
+
+// Tree partitioned by top-level key into a fixed number of shards, each an
+// ObservableTree with its own lock, subscription index and root holding the
+// top-level branches of its keys. Writers to branches of different shards do
+// not contend. Paths passed to and by a shard are full paths from the root.
+//
+// Root updates need forEachChild to split the new root, they are applied
+// shard by shard and are not atomic across shards. Root reads are consistent:
+// all shards are locked while their roots are copied. The empty path only
+// reads or writes the whole root. Subscriptions cannot start with a wildcard,
+// which would only match the branches of one shard.
+template <class Node, class Trait, class Path = otree::Path,
+          class Key = otree::Path::KeyType, class Mutex = std::mutex,
+          class Index = MapIndex, class Instrumentation = NoInstrumentation>
+class ShardedObservableTree {
+ public:
+  using ShardType =
+      ObservableTree<Node, Trait, Path, Key, Mutex, Index, Instrumentation>;
+  using NodeType = Node;
+  using TraitType = Trait;
+  using PathType = Path;
+  using KeyType = Key;
+  using MutexType = Mutex;
+  using SignalPtrType = typename ShardType::SignalPtrType;
+
+  static_assert(detail::canMakePath<Trait, Path, Key>(),
+                "Sharding needs paths constructible from their keys");
+
+  explicit ShardedObservableTree(size_t shardCount = 16)
+      : shards_(std::max<size_t>(shardCount, 1)) {
+    for (auto &shard : shards_) {
+      shard = std::make_unique<ShardType>();
+    }
+  }
+
+  ShardType &shard(const KeyType &key) { return *shards_[shardIndex(key)]; }
+
+  // Throws std::invalid_argument if the first key is a wildcard
+  SignalPtrType modificationSignal(const PathType &path) {
+    if (auto key = firstKey(path)) {
+      if constexpr (SignalMgr<ShardType>::HasWildcards) {
+        if (detail::wildcard<KeyType>(*key) != detail::Wildcard::None) {
+          throw std::invalid_argument{
+              "a top-level wildcard would only match one shard"};
+        }
+      }
+      return shard(*key).modificationSignal(path);
+    }
+    return {};
+  }
+
+  template <class... Options>
+  auto changes(const PathType &path, Options &&... options) {
+    return ChangeStream<ShardType>{modificationSignal(path),
+                                   std::forward<Options>(options)...};
+  }
+
+  PathHandle<ShardType> resolve(const PathType &path) {
+    return shardOf(path).resolve(path);
+  }
+
+  // Sum of the shard versions, which moves with every write of any shard
+  std::uint64_t version() const {
+    auto version = std::uint64_t{0};
+    for (const auto &shard : shards_) {
+      version += shard->version();
+    }
+    return version;
+  }
+
+  // Version from the shard of the path, the empty path has the tree version
+  std::uint64_t version(const PathType &path) {
+    if (auto key = firstKey(path)) {
+      return shard(*key).version(path);
+    }
+    return version();
+  }
+
+  std::uint64_t version(PathHandle<ShardType> &handle) {
+    if (firstKey(handle.path())) {
+      return shardOf(handle.path()).version(handle);
+    }
+    return version();
+  }
+
+  void setDispatchMode(DispatchMode mode, Executor executor = {}) {
+    for (auto &shard : shards_) {
+      shard->setDispatchMode(mode, executor);
+    }
+  }
+
+  void setParallelDiff(const ParallelDiff &parallel) {
+    for (auto &shard : shards_) {
+      shard->setParallelDiff(parallel);
+    }
+  }
+
+  void set(const NodeType &newData) {
+    static_assert(
+        detail::HasForEachChild<TraitType, NodeType, KeyType>::value,
+        "Root updates of a sharded tree need Trait::forEachChild");
+    auto roots = std::vector<NodeType>(shards_.size());
+    TraitType::forEachChild(
+        newData, [&](const KeyType &key, const NodeType &child) {
+          TraitType::set(roots[shardIndex(key)], keyPath(key), child);
+        });
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      shards_[i]->set(std::move(roots[i]));
+    }
+  }
+
+  void set(const PathType &path, const NodeType &newNode) {
+    if (auto key = firstKey(path)) {
+      shard(*key).set(path, newNode);
+    } else {
+      set(newNode);
+    }
+  }
+
+  void set(const PathType &path, NodeType &&newNode) {
+    if (auto key = firstKey(path)) {
+      shard(*key).set(path, std::move(newNode));
+    } else {
+      set(static_cast<const NodeType &>(newNode));
+    }
+  }
+
+  void set(PathHandle<ShardType> &handle, const NodeType &newNode) {
+    shardOf(handle.path()).set(handle, newNode);
+  }
+
+  void set(PathHandle<ShardType> &handle, NodeType &&newNode) {
+    shardOf(handle.path()).set(handle, std::move(newNode));
+  }
+
+  NodeType get(PathHandle<ShardType> &handle) {
+    return shardOf(handle.path()).get(handle);
+  }
+
+  NodeType get() const {
+    static_assert(
+        detail::HasForEachChild<TraitType, NodeType, KeyType>::value,
+        "Root reads of a sharded tree need Trait::forEachChild");
+    auto roots = std::vector<NodeType>{};
+    roots.reserve(shards_.size());
+    {
+      // shards are always locked in the same order
+      auto locks = std::vector<std::unique_lock<MutexType>>{};
+      locks.reserve(shards_.size());
+      for (const auto &shard : shards_) {
+        locks.emplace_back(shard->mutex_);
+      }
+      for (const auto &shard : shards_) {
+        roots.push_back(shard->root_);
+      }
+    }
+    auto root = NodeType{};
+    for (const auto &shardRoot : roots) {
+      TraitType::forEachChild(
+          shardRoot, [&](const KeyType &key, const NodeType &child) {
+            TraitType::set(root, keyPath(key), child);
+          });
+    }
+    return root;
+  }
+
+  NodeType get(const PathType &path) {
+    if (auto key = firstKey(path)) {
+      return shard(*key).get(path);
+    }
+    return get();
+  }
+
+  template <typename T>
+  T get(const PathType &path) {
+    if (auto key = firstKey(path)) {
+      return shard(*key).template get<T>(path);
+    }
+    return TraitType::template get<T>(get(), path);
+  }
+
+  // Calls `fn` with the live node at `path` under the lock of its shard, the
+  // empty path gets a copy of the root
+  template <class Fn>
+  decltype(auto) visit(const PathType &path, Fn &&fn) const {
+    if (auto key = firstKey(path)) {
+      return shards_[shardIndex(*key)]->visit(path, std::forward<Fn>(fn));
+    }
+    return fn(static_cast<const NodeType &>(get()));
+  }
+
+  PruneCounts prune() {
+    auto counts = PruneCounts{};
+    for (auto &shard : shards_) {
+      counts += shard->prune();
+    }
+    return counts;
+  }
+
+  PruneCounts pruneCounts() const {
+    auto counts = PruneCounts{};
+    for (const auto &shard : shards_) {
+      counts += shard->pruneCounts();
+    }
+    return counts;
+  }
+
+ private:
+  size_t shardIndex(const KeyType &key) const {
+    return std::hash<KeyType>{}(key) % shards_.size();
+  }
+
+  // Copied, path iterators may own the keys they point to
+  static std::optional<KeyType> firstKey(const PathType &path) {
+    using std::begin;
+    using std::end;
+    auto it = begin(path);
+    if (it != end(path)) {
+      return *it;
+    }
+    return std::nullopt;
+  }
+
+  // The first shard for the empty path
+  ShardType &shardOf(const PathType &path) {
+    auto key = firstKey(path);
+    return key ? shard(*key) : *shards_.front();
+  }
+
+  static PathType keyPath(const KeyType &key) {
+    return detail::makePath<TraitType, PathType>(
+        std::vector<const KeyType *>{&key});
+  }
+
+  std::vector<std::unique_ptr<ShardType>> shards_;
+};
+
+}  // namespace otree
@@ -0,0 +1,495 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace otree {
+
+namespace detail {
+
+// Header of a shared memory ring written by one publisher and read by any
+// number of replicas, each at its own position. Positions count the bytes
+// written since creation. The publisher advances `reserved` before it
+// overwrites old frames and `published` once a frame is complete, a replica
+// whose copied frame may have been overwritten meanwhile sees `reserved` more
+// than a ring ahead of it.
+struct ShmFeedHeader {
+  static constexpr std::uint64_t Magic = 0x6f74726565666431ull;
+
+  std::atomic<std::uint64_t> magic;
+  std::uint64_t capacity;
+  std::atomic<std::uint64_t> reserved;
+  std::atomic<std::uint64_t> published;
+  std::atomic<std::uint32_t> snapshotRequests;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+                  std::atomic<std::uint32_t>::is_always_lock_free,
+              "Shared memory feeds need address free atomics");
+
+// Frames are a 4 byte size, 4 byte kind and their records, 4 byte aligned. A
+// frame that does not fit before the end of the ring starts at its beginning,
+// after a wrap marker. A Root frame replaces the root of all replicas, a
+// Snapshot frame only of those waiting for one.
+enum class FeedFrame : std::uint32_t { Changes, Snapshot, Root };
+enum class FeedOp : std::uint8_t { Set, Erase, Merge };
+constexpr std::uint32_t FeedWrap = ~std::uint32_t{0};
+
+// Frames larger than half the ring are written as parts of an eighth of the
+// ring at most, up to FeedMaxParts of them so that a replica can read them all
+// before they are overwritten. Flags of the kind: FeedMore on all parts but
+// the last, FeedContinued on all parts but the first.
+constexpr std::uint32_t FeedMore = 1u << 31;
+constexpr std::uint32_t FeedContinued = 1u << 30;
+constexpr size_t FeedMaxParts = 7;
+
+// Bytes of records a part carries
+inline size_t feedPartRecords(size_t capacity) { return capacity / 8 - 8; }
+
+class ShmMapping {
+ public:
+  // Creating replaces the segment of a previous owner that was not removed
+  ShmMapping(const std::string &name, size_t capacity, bool create)
+      : name_{name}, owner_{create} {
+    if (create) {
+      ::shm_unlink(name.c_str());
+    }
+    auto fd = create ? ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)
+                     : ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      throw std::system_error{errno, std::generic_category(), name};
+    }
+    if (create && ::ftruncate(fd, static_cast<off_t>(
+                                      sizeof(ShmFeedHeader) + capacity)) < 0) {
+      fail(fd);
+    }
+    if (!create) {
+      struct stat st;
+      if (::fstat(fd, &st) < 0) {
+        fail(fd);
+      }
+      capacity = static_cast<size_t>(st.st_size) - sizeof(ShmFeedHeader);
+    }
+    size_ = sizeof(ShmFeedHeader) + capacity;
+    data_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data_ == MAP_FAILED) {
+      fail(fd);
+    }
+    ::close(fd);
+  }
+
+  ~ShmMapping() {
+    ::munmap(data_, size_);
+    if (owner_) {
+      ::shm_unlink(name_.c_str());
+    }
+  }
+
+  ShmMapping(const ShmMapping &) = delete;
+  ShmMapping &operator=(const ShmMapping &) = delete;
+
+  ShmFeedHeader &header() { return *static_cast<ShmFeedHeader *>(data_); }
+  char *ring() { return static_cast<char *>(data_) + sizeof(ShmFeedHeader); }
+
+ private:
+  [[noreturn]] void fail(int fd) {
+    auto error = errno;
+    ::close(fd);
+    if (owner_) {
+      ::shm_unlink(name_.c_str());
+    }
+    throw std::system_error{error, std::generic_category(), name_};
+  }
+
+  std::string name_;
+  bool owner_;
+  void *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+inline void putU32(std::string &buffer, std::uint32_t value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+inline std::uint32_t getU32(const char *data) {
+  auto value = std::uint32_t{};
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+inline size_t alignFrame(size_t size) { return (size + 3) & ~size_t{3}; }
+
+}  // namespace detail
+
+// Writes the updates of a tree to a POSIX shared memory ring so that replica
+// trees in other processes of the host apply them instead of parsing and
+// diffing whole documents. Root updates are published as the changes of their
+// diff pass in ChangeScope::Patch, path updates and merge patches as they are.
+// All updates of the tree must go through the publisher. It may be called from
+// any thread: each call holds the publisher lock across the tree update and
+// the write of its frame, so frames are in the order of the updates.
+//
+// Codec converts nodes to bytes and back:
+//   static std::string encode(const NodeType &);
+//   static NodeType decode(std::string_view);
+//
+// The ring is created, and removed on destruction, under `name`, e.g.
+// "/config". Writers never wait for replicas: a replica that falls a ring
+// behind loses its place and asks for a snapshot of the root, written on the
+// next update or serveSnapshots().
+//
+// A frame holds up to 7/8 of the capacity. Updates whose frame would not fit
+// throw std::length_error and leave the tree unchanged: root updates encode
+// the new root first, and publish it whole when their changes would not fit.
+// A root grown by path updates or merges beyond the limit cannot be served as
+// a snapshot: serveSnapshots() throws std::length_error and the requests wait
+// until the root fits again.
+template <class Tree, class Codec>
+class ShmFeedPublisher {
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using TraitType = typename Tree::TraitType;
+
+ public:
+  ShmFeedPublisher(Tree &tree, const std::string &name,
+                   size_t capacity = 1 << 20)
+      : tree_{tree}, shm_{name, detail::alignFrame(capacity), true} {
+    auto &header = *new (&shm_.header()) detail::ShmFeedHeader{};
+    header.capacity = detail::alignFrame(capacity);
+    header.magic.store(detail::ShmFeedHeader::Magic,
+                       std::memory_order_release);
+  }
+
+  void set(const NodeType &newData) {
+    LockGuard lock(mutex_);
+    beginFrame(detail::FeedFrame::Root);
+    putRecord(detail::FeedOp::Set, PathType{}, &newData);
+    checkFits();
+    auto root = std::move(frame_);
+    auto changes = ChangeSet<Tree>{};
+    tree_.set(newData, changes, ChangeScope::Patch);
+    beginFrame(detail::FeedFrame::Changes);
+    for (const auto &change : changes) {
+      using std::begin;
+      using std::end;
+      // the root is never erased, it is left empty
+      if (TraitType::empty(change.newNode) &&
+          begin(change.path) != end(change.path)) {
+        putRecord(detail::FeedOp::Erase, change.path, nullptr);
+      } else {
+        putRecord(detail::FeedOp::Set, change.path, &change.newNode);
+      }
+    }
+    if (frame_.size() > root.size()) {
+      frame_ = std::move(root);
+    }
+    endFrame();
+  }
+
+  void set(const PathType &path, const NodeType &newNode) {
+    LockGuard lock(mutex_);
+    beginFrame(detail::FeedFrame::Changes);
+    putRecord(detail::FeedOp::Set, path, &newNode);
+    checkFits();
+    tree_.set(path, newNode);
+    endFrame();
+  }
+
+  void merge(const NodeType &patch) {
+    LockGuard lock(mutex_);
+    beginFrame(detail::FeedFrame::Changes);
+    putRecord(detail::FeedOp::Merge, PathType{}, &patch);
+    checkFits();
+    tree_.merge(patch);
+    endFrame();
+  }
+
+  // Writes a snapshot if a replica asked for one, e.g. while no updates come.
+  // Throws std::length_error if the root does not fit in a frame.
+  void serveSnapshots() {
+    LockGuard lock(mutex_);
+    if (!writeSnapshot()) {
+      throw std::length_error{"the root exceeds the frame limit of the feed"};
+    }
+  }
+
+ private:
+  // False if the snapshot asked for does not fit, the requests are kept
+  bool writeSnapshot() {
+    auto &requests = shm_.header().snapshotRequests;
+    if (auto count = requests.exchange(0, std::memory_order_acquire)) {
+      auto root = tree_.get();
+      beginFrame(detail::FeedFrame::Snapshot);
+      putRecord(detail::FeedOp::Set, PathType{}, &root);
+      if (!fits()) {
+        requests.fetch_add(count, std::memory_order_relaxed);
+        return false;
+      }
+      write();
+    }
+    return true;
+  }
+
+  bool fits() {
+    auto capacity = shm_.header().capacity;
+    return detail::alignFrame(frame_.size()) <= capacity / 2 ||
+           frame_.size() - 8 <=
+               detail::FeedMaxParts * detail::feedPartRecords(capacity);
+  }
+
+  void checkFits() {
+    if (!fits()) {
+      throw std::length_error{"the update exceeds the frame limit of the feed"};
+    }
+  }
+
+  void beginFrame(detail::FeedFrame kind) {
+    frame_.clear();
+    detail::putU32(frame_, 0);
+    detail::putU32(frame_, static_cast<std::uint32_t>(kind));
+  }
+
+  void putRecord(detail::FeedOp op, const PathType &path,
+                 const NodeType *node) {
+    frame_.push_back(static_cast<char>(op));
+    auto keys = std::uint32_t{0};
+    auto countAt = frame_.size();
+    detail::putU32(frame_, 0);
+    for (const auto &key : path) {
+      const std::string &name = key;
+      detail::putU32(frame_, static_cast<std::uint32_t>(name.size()));
+      frame_ += name;
+      ++keys;
+    }
+    std::memcpy(&frame_[countAt], &keys, sizeof(keys));
+    auto value = node ? Codec::encode(*node) : std::string{};
+    detail::putU32(frame_, static_cast<std::uint32_t>(value.size()));
+    frame_ += value;
+  }
+
+  void endFrame() {
+    write();
+    writeSnapshot();
+  }
+
+  // Writes the frame, split into parts if it exceeds half the ring
+  void write() {
+    auto capacity = shm_.header().capacity;
+    auto kind = detail::getU32(&frame_[4]);
+    if (detail::alignFrame(frame_.size()) <= capacity / 2) {
+      writePart(kind, 8, frame_.size());
+      return;
+    }
+    auto records = detail::feedPartRecords(capacity);
+    for (size_t at = 8; at < frame_.size(); at += records) {
+      auto last = std::min(frame_.size(), at + records);
+      auto flags = (at > 8 ? detail::FeedContinued : 0) |
+                   (last < frame_.size() ? detail::FeedMore : 0);
+      writePart(kind | flags, at, last);
+    }
+  }
+
+  // Writes a frame of `kind` holding the records of frame_ in [first, last)
+  void writePart(std::uint32_t kind, size_t first, size_t last) {
+    auto &header = shm_.header();
+    auto capacity = header.capacity;
+    auto size = static_cast<std::uint32_t>(8 + last - first);
+    auto length = detail::alignFrame(size);
+    auto start = header.published.load(std::memory_order_relaxed);
+    auto offset = start % capacity;
+    auto skip = capacity - offset < length ? capacity - offset : 0;
+    header.reserved.store(start + skip + length, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (skip) {
+      std::memcpy(shm_.ring() + offset, &detail::FeedWrap,
+                  sizeof(detail::FeedWrap));
+      offset = 0;
+    }
+    std::memcpy(shm_.ring() + offset, &size, sizeof(size));
+    std::memcpy(shm_.ring() + offset + 4, &kind, sizeof(kind));
+    std::memcpy(shm_.ring() + offset + 8, frame_.data() + first, last - first);
+    header.published.store(start + skip + length, std::memory_order_release);
+  }
+
+  Tree &tree_;
+  detail::ShmMapping shm_;
+  std::mutex mutex_;
+  std::string frame_;
+};
+
+// Applies the updates written by a ShmFeedPublisher to a local tree, which
+// notifies its own subscriptions. The frame of each update is committed as a
+// Transaction, so it takes one diff pass. The replica starts from a snapshot
+// it asks for when opened and ignores updates until it arrives.
+template <class Tree, class Codec>
+class ShmFeedReplica {
+  using NodeType = typename Tree::NodeType;
+  using PathType = typename Tree::PathType;
+  using KeyType = typename Tree::KeyType;
+  using TraitType = typename Tree::TraitType;
+
+ public:
+  ShmFeedReplica(Tree &tree, const std::string &name)
+      : tree_{tree}, shm_{name, 0, false} {
+    auto &header = shm_.header();
+    if (header.magic.load(std::memory_order_acquire) !=
+        detail::ShmFeedHeader::Magic) {
+      throw std::system_error{EINVAL, std::generic_category(), name};
+    }
+    position_ = header.published.load(std::memory_order_acquire);
+    requestSnapshot();
+  }
+
+  // Applies the frames published since the last call, returns their number
+  size_t poll() {
+    auto &header = shm_.header();
+    auto capacity = header.capacity;
+    auto applied = size_t{0};
+    while (true) {
+      auto published = header.published.load(std::memory_order_acquire);
+      if (position_ == published) {
+        return applied;
+      }
+      auto offset = position_ % capacity;
+      auto skip = size_t{0};
+      if (detail::getU32(shm_.ring() + offset) == detail::FeedWrap) {
+        skip = capacity - offset;
+        offset = 0;
+      }
+      auto size = detail::getU32(shm_.ring() + offset);
+      frame_.assign(shm_.ring() + offset,
+                    size <= capacity - offset ? size : 0);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (published - position_ > capacity ||
+          header.reserved.load(std::memory_order_relaxed) - position_ >
+              capacity) {
+        ++overruns_;
+        position_ = published;
+        parts_.clear();
+        requestSnapshot();
+        continue;
+      }
+      position_ += skip + detail::alignFrame(size);
+      if (assemble()) {
+        applied += apply();
+      }
+    }
+  }
+
+  // False until the first snapshot and after an overrun
+  bool synced() const { return synced_; }
+
+  // Times the replica fell a ring behind
+  size_t overruns() const { return overruns_; }
+
+ private:
+  void requestSnapshot() {
+    synced_ = false;
+    shm_.header().snapshotRequests.fetch_add(1, std::memory_order_release);
+  }
+
+  // Joins the parts of a split frame into frame_, false until its last part
+  // or if the replica started after its first part
+  bool assemble() {
+    auto kind = detail::getU32(&frame_[4]);
+    auto flags = kind & (detail::FeedMore | detail::FeedContinued);
+    if (!flags) {
+      return true;
+    }
+    if (!(flags & detail::FeedContinued)) {
+      parts_ = frame_;
+    } else if (parts_.empty()) {
+      return false;
+    } else {
+      parts_.append(frame_, 8, std::string::npos);
+    }
+    if (flags & detail::FeedMore) {
+      return false;
+    }
+    frame_.swap(parts_);
+    parts_.clear();
+    kind &= ~flags;
+    std::memcpy(&frame_[4], &kind, sizeof(kind));
+    return true;
+  }
+
+  size_t apply() {
+    auto kind = static_cast<detail::FeedFrame>(detail::getU32(&frame_[4]));
+    // changes apply to synced replicas, snapshots to the others, roots to all
+    auto skip = kind == detail::FeedFrame::Changes
+                    ? !synced_
+                    : kind == detail::FeedFrame::Snapshot && synced_;
+    if (skip) {
+      return 0;
+    }
+    synced_ = true;
+    auto transaction = tree_.begin();
+    auto keys = std::vector<KeyType>{};
+    for (size_t at = 8; at < frame_.size();) {
+      auto op = static_cast<detail::FeedOp>(frame_[at++]);
+      keys.clear();
+      auto count = detail::getU32(&frame_[at]);
+      at += 4;
+      for (std::uint32_t i = 0; i < count; ++i) {
+        auto length = detail::getU32(&frame_[at]);
+        keys.push_back(KeyType{std::string{&frame_[at + 4], length}});
+        at += 4 + length;
+      }
+      auto length = detail::getU32(&frame_[at]);
+      auto value = std::string_view{frame_.data() + at + 4, length};
+      at += 4 + length;
+      auto path = makePath(keys);
+      switch (op) {
+        case detail::FeedOp::Set:
+          transaction.set(path, Codec::decode(value));
+          break;
+        case detail::FeedOp::Erase:
+          transaction.erase(path);
+          break;
+        case detail::FeedOp::Merge:
+          transaction.commit();
+          tree_.merge(Codec::decode(value));
+          break;
+      }
+    }
+    transaction.commit();
+    return 1;
+  }
+
+  static PathType makePath(const std::vector<KeyType> &keys) {
+    auto pointers = std::vector<const KeyType *>{};
+    for (const auto &key : keys) {
+      pointers.push_back(&key);
+    }
+    return detail::makePath<TraitType, PathType>(pointers);
+  }
+
+  Tree &tree_;
+  detail::ShmMapping shm_;
+  std::string frame_;
+  // parts of a split frame read so far
+  std::string parts_;
+  std::uint64_t position_ = 0;
+  size_t overruns_ = 0;
+  bool synced_ = false;
+};
+
+}  // namespace otree
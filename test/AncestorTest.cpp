@@ -0,0 +1,92 @@
+// Ancestors and descendants of the path notified by set(path, node)
+#include <otree/ObservableTree.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+// Records the notified subscription paths, sorted by notified()
+auto observe(Tree &tree, const std::string &path,
+             std::vector<std::string> &notified) {
+  return tree.modificationSignal(path)->connect(
+      [&notified, path](const Path &, const json11::Json &,
+                        const json11::Json &) { notified.push_back(path); });
+}
+
+std::vector<std::string> notified(std::vector<std::string> &paths) {
+  auto sorted = std::move(paths);
+  paths.clear();
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+
+void ancestorsAndDescendants() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"b", Object{{"c", 1}, {"d", 2}}}}}});
+  auto paths = std::vector<std::string>{};
+  auto c1 = observe(tree, "a", paths);
+  auto c2 = observe(tree, "a/b", paths);
+  auto c3 = observe(tree, "a/b/c", paths);
+  auto c4 = observe(tree, "a/b/d", paths);
+  auto c5 = observe(tree, "e", paths);
+  tree.set("a/b", Object{{"c", 3}, {"d", 2}});
+  check(notified(paths) == std::vector<std::string>{"a", "a/b", "a/b/c"},
+        "the ancestors and the changed descendants are notified");
+  tree.set("a/b", Object{{"c", 3}, {"d", 2}});
+  check(paths.empty(), "an unchanged subtree notifies nobody");
+  tree.set("a/b/d", json11::Json{});
+  check(notified(paths) == std::vector<std::string>{"a", "a/b", "a/b/d"},
+        "erasing a leaf notifies its ancestors");
+}
+
+void emptyNodeBelowScalar() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}});
+  auto paths = std::vector<std::string>{};
+  auto c1 = observe(tree, "a", paths);
+  auto c2 = observe(tree, "a/a", paths);
+  tree.set("a/a", json11::Json{});
+  check(tree.get("a").is_object(), "the scalar is replaced by an object");
+  check(notified(paths) == std::vector<std::string>{"a"},
+        "the replaced ancestor is notified, the empty node is not");
+  tree.set("a/a", json11::Json{});
+  check(paths.empty(), "writing the same empty node again notifies nobody");
+}
+
+void missingPath() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"x", 1}}}});
+  auto paths = std::vector<std::string>{};
+  auto c1 = observe(tree, "a", paths);
+  auto c2 = observe(tree, "a/b", paths);
+  tree.set("a/b/c", 2);
+  check(notified(paths) == std::vector<std::string>{"a", "a/b"},
+        "creating a path notifies the ancestors along it");
+  auto before = tree.get("a");
+  tree.set("a/q/r", json11::Json{});
+  auto expected = before == tree.get("a") ? std::vector<std::string>{}
+                                          : std::vector<std::string>{"a"};
+  check(notified(paths) == expected,
+        "an empty node notifies the ancestors if the write created nodes");
+}
+
+int main() {
+  try {
+    ancestorsAndDescendants();
+    emptyNodeBelowScalar();
+    missingPath();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
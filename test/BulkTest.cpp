@@ -0,0 +1,72 @@
+// Subscriptions made and dropped in bulk
+#include <otree/ObservableTree.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+using Slot = std::function<void(const json11::Json &, const json11::Json &)>;
+
+// Slot recording `name` into `called`
+Slot record(std::vector<std::string> &called, const std::string &name) {
+  return [&called, name](const json11::Json &, const json11::Json &) {
+    called.push_back(name);
+  };
+}
+
+void subscribeAndDisconnect() {
+  auto tree = Tree{};
+  auto called = std::vector<std::string>{};
+  auto subscriptions = std::vector<std::pair<std::string, Slot>>{
+      {"a/b", record(called, "a/b")},
+      {"a/c", record(called, "a/c")},
+      {"a/c", record(called, "a/c again")},
+      {"d", record(called, "d")},
+  };
+  auto connections = tree.subscribeMany(subscriptions);
+  check(connections.size() == 4, "one connection per subscription");
+  tree.set(Object{{"a", Object{{"b", 1}, {"c", 2}}}, {"d", 3}});
+  check(called == std::vector<std::string>{"a/b", "a/c", "a/c again", "d"},
+        "every slot is connected to its path");
+  called.clear();
+  connections[1].disconnect();
+  tree.set("a/c", 4);
+  check(called == std::vector<std::string>{"a/c again"},
+        "the connections are in the order of the subscriptions");
+  auto pruned = tree.disconnectMany(connections);
+  check(pruned.signals == 3 && pruned.entries == 4,
+        "disconnectMany() prunes the index once");
+  called.clear();
+  tree.set(Object{{"a", 1}});
+  check(called.empty(), "no slot is left");
+}
+
+void movedSlots() {
+  auto tree = Tree{};
+  auto called = std::vector<std::string>{};
+  auto connections = tree.subscribeMany(std::vector<std::pair<Path, Slot>>{
+      {Path{"x/y"}, record(called, "x/y")}, {Path{"x/z"}, nullptr}});
+  tree.set(Object{{"x", Object{{"y", 1}, {"z", 2}}}});
+  check(connections.size() == 2 && called.size() == 1,
+        "slots are moved from temporary subscriptions, empty ones are kept");
+}
+
+int main() {
+  try {
+    subscribeAndDisconnect();
+    movedSlots();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Change sets reported by set() in each ChangeScope
+#include <otree/ObservableTree.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+// Compact form independent of the spacing of Json::dump()
+std::string format(const json11::Json &node) {
+  if (!node.is_object()) {
+    return node.dump();
+  }
+  auto formatted = std::string{"{"};
+  for (const auto &[key, child] : node.object_items()) {
+    formatted += (formatted.size() > 1 ? "," : "") + key + ":" + format(child);
+  }
+  return formatted + "}";
+}
+
+// "path:old>new" of each change, sorted
+std::vector<std::string> describe(const ChangeSet<Tree> &changes) {
+  auto described = std::vector<std::string>{};
+  for (const auto &change : changes) {
+    described.push_back(change.path.toString() + ":" +
+                        format(change.oldNode) + ">" + format(change.newNode));
+  }
+  std::sort(described.begin(), described.end());
+  return described;
+}
+
+json11::Json first() {
+  return Object{{"a", Object{{"b", 1}, {"c", 2}}}, {"d", Object{{"e", 3}}}};
+}
+
+json11::Json second() {
+  return Object{{"a", Object{{"b", 1}, {"c", 4}, {"f", 5}}}, {"d", 6}};
+}
+
+void observed() {
+  auto tree = Tree{};
+  tree.set(first());
+  auto connection = tree.modificationSignal("a")->connect(
+      [](const json11::Json &, const json11::Json &) {});
+  auto held = tree.modificationSignal("d/e");
+  auto changes = ChangeSet<Tree>{};
+  tree.set(second(), changes, ChangeScope::Observed);
+  check(describe(changes) == std::vector<std::string>{
+                                 "a:{b:1,c:2}>{b:1,c:4,f:5}",
+                                 "d/e:3>null"},
+        "the observed paths are recorded, with or without slots");
+}
+
+void all() {
+  auto tree = Tree{};
+  tree.set(first());
+  auto changes = ChangeSet<Tree>{};
+  tree.set(second(), changes, ChangeScope::All);
+  check(describe(changes) == std::vector<std::string>{"a/c:2>4", "a/f:null>5",
+                                                      "d:{e:3}>6"},
+        "the leaf-most changes are recorded, d is replaced whole");
+  changes.clear();
+  tree.set(second(), changes, ChangeScope::All);
+  check(changes.empty(), "an equal root records nothing");
+}
+
+void objectReplacedByScalar() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"c", 1}}}});
+  auto changes = ChangeSet<Tree>{};
+  tree.set(Object{{"a", 2}}, changes, ChangeScope::All);
+  check(describe(changes) == std::vector<std::string>{"a:{c:1}>2"},
+        "the new value of a replaced object is recorded");
+  changes.clear();
+  tree.set(Object{{"a", Object{{"c", 1}}}}, changes, ChangeScope::All);
+  check(describe(changes) == std::vector<std::string>{"a:2>{c:1}"},
+        "the old value of a replaced scalar is recorded");
+}
+
+void patch() {
+  auto tree = Tree{};
+  tree.set(first());
+  auto changes = ChangeSet<Tree>{};
+  tree.set(second(), changes, ChangeScope::Patch);
+  auto patched = first();
+  for (const auto &change : changes) {
+    if (change.newNode.is_null()) {
+      Json11Trait::erase(patched, change.path);
+    } else {
+      Json11Trait::set(patched, change.path, change.newNode);
+    }
+  }
+  check(patched == second(), "the records patch the old root into the new");
+}
+
+int main() {
+  try {
+    observed();
+    all();
+    objectReplacedByScalar();
+    patch();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
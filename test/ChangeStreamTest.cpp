@@ -0,0 +1,149 @@
+// ChangeStream consumers awaiting the changes of a tree
+#include <otree/ChangeStream.h>
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                            otree::Path::KeyType, std::mutex>;
+
+// Coroutine started eagerly, destroyed with the object
+class Task {
+ public:
+  struct promise_type {
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  Task(Task &&other) : handle_{std::exchange(other.handle_, {})} {}
+  Task &operator=(Task &&) = delete;
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool done() const { return handle_.done(); }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_{handle} {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+std::string describe(const Change<Tree> &change) {
+  return change.path.toString() + ":" + change.oldNode.dump() + ">" +
+         change.newNode.dump();
+}
+
+// Records the changes, each with the node the tree holds at its path then
+Task consume(Tree &tree, ChangeStream<Tree> &stream,
+             std::vector<std::string> &out) {
+  while (auto change = co_await stream.next()) {
+    out.push_back(describe(*change) + "@" + tree.get(change->path).dump());
+  }
+  out.push_back("closed");
+}
+
+void nextResumesAfterTheUpdate() {
+  auto tree = Tree{};
+  auto stream = tree.changes("*");
+  auto out = std::vector<std::string>{};
+  auto task = consume(tree, stream, out);
+  check(out.empty(), "next() waits for a change");
+  // the consumer reads the tree, which is not locked anymore
+  tree.set("a", 1);
+  tree.set("a", 2);
+  check(out == std::vector<std::string>{"a:null>1@1", "a:1>2@2"},
+        "each change resumes the consumer");
+  stream.close();
+  check(task.done() && out.back() == "closed",
+        "close() ends a pending next()");
+  tree.set("a", 3);
+  check(out.size() == 3, "a closed stream is disconnected");
+}
+
+void dropOldest() {
+  auto tree = Tree{};
+  auto stream = tree.changes("*", StreamOptions{2, Overflow::DropOldest});
+  for (int i = 1; i <= 5; ++i) {
+    tree.set("a", i);
+  }
+  check(stream.dropped() == 3, "the changes beyond the capacity are dropped");
+  stream.close();
+  auto out = std::vector<std::string>{};
+  auto task = consume(tree, stream, out);
+  check(out == std::vector<std::string>{"a:3>4@5", "a:4>5@5", "closed"},
+        "the latest changes are drained before the close");
+}
+
+void coalesce() {
+  auto tree = Tree{};
+  auto stream = tree.changes("*", StreamOptions{3, Overflow::Coalesce});
+  tree.set("a", 1);
+  tree.set("a", 2);
+  tree.set("b", 1);
+  // full, joins the most recent change of a
+  tree.set("a", 3);
+  // full without a change of c, drops the oldest
+  tree.set("c", 1);
+  check(stream.dropped() == 2, "coalesced and dropped changes are counted");
+  stream.close();
+  auto out = std::vector<std::string>{};
+  auto task = consume(tree, stream, out);
+  check(out == std::vector<std::string>{"a:1>3@3", "b:null>1@1",
+                                        "c:null>1@1", "closed"},
+        "a coalesced change keeps its old node and place");
+}
+
+void executor() {
+  auto tree = Tree{};
+  auto posted = std::deque<std::function<void()>>{};
+  auto options = StreamOptions{};
+  options.executor = [&](std::function<void()> fn) {
+    posted.push_back(std::move(fn));
+  };
+  auto stream = tree.changes("*", options);
+  auto out = std::vector<std::string>{};
+  auto task = consume(tree, stream, out);
+  tree.set("a", 1);
+  check(out.empty() && posted.size() == 1, "the executor resumes");
+  posted.front()();
+  posted.pop_front();
+  check(out == std::vector<std::string>{"a:null>1@1"},
+        "the consumer runs on the executor");
+  stream.close();
+  check(posted.size() == 1 && !task.done(), "the close is posted too");
+  posted.front()();
+  check(task.done(), "the executor ends the consumer");
+}
+
+int main() {
+  try {
+    nextResumesAfterTheUpdate();
+    dropOldest();
+    coalesce();
+    executor();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// Throws unless `condition` holds, the test mains report it and fail
+inline void check(bool condition, const std::string &what) {
+  if (!condition) {
+    throw std::runtime_error{"check failed: " + what};
+  }
+}
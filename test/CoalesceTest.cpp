@@ -0,0 +1,92 @@
+// Coalesce adaptor driven by a manual CoalescingTimer
+#include <otree/Coalesce.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+using namespace std::chrono_literals;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+
+// Past the due time of everything scheduled so far
+CoalescingTimer::Clock::time_point later() {
+  return CoalescingTimer::Clock::now() + 1h;
+}
+
+void firstOldLatestNew() {
+  auto timer = CoalescingTimer{CoalescingTimer::Mode::Manual};
+  auto tree = Tree{};
+  tree.set("v", 0);
+  auto delivered = std::vector<std::pair<int, int>>{};
+  auto connection = tree.modificationSignal("v")->connect(
+      [&](const json11::Json &oldNode, const json11::Json &newNode) {
+        delivered.emplace_back(oldNode.int_value(), newNode.int_value());
+      },
+      Coalesce{10ms, {}, &timer});
+  for (int i = 1; i <= 100; ++i) {
+    tree.set("v", i);
+  }
+  check(delivered.empty(), "nothing is delivered before the interval");
+  check(timer.tick(CoalescingTimer::Clock::now() - 1h) == 0,
+        "nothing is due before the interval");
+  check(timer.tick(later()) == 1, "one delivery per interval");
+  check(delivered == std::vector<std::pair<int, int>>{{0, 100}},
+        "the first old node and the latest new node");
+  tree.set("v", 101);
+  check(timer.tick(later()) == 1 &&
+            delivered.back() == std::pair<int, int>{100, 101},
+        "the next interval starts from the delivered node");
+}
+
+void severalPaths() {
+  auto timer = CoalescingTimer{CoalescingTimer::Mode::Manual};
+  auto tree = Tree{};
+  auto delivered = std::vector<std::string>{};
+  auto connection = tree.modificationSignal("w/*")->connect(
+      [&](const Path &path, const json11::Json &oldNode,
+          const json11::Json &newNode) {
+        delivered.push_back(path.toString() + ":" + oldNode.dump() + ">" +
+                            newNode.dump());
+      },
+      Coalesce{10ms, {}, &timer});
+  for (int i = 1; i <= 10; ++i) {
+    tree.set("w/b", i);
+    if (i % 2) {
+      tree.set("w/a", i);
+    }
+  }
+  check(timer.tick(later()) == 1, "the paths share one delivery");
+  check(delivered == std::vector<std::string>{"w/a:null>9", "w/b:null>10"},
+        "each path gets its first old node and latest new node");
+}
+
+void disconnectWhilePending() {
+  auto timer = CoalescingTimer{CoalescingTimer::Mode::Manual};
+  auto tree = Tree{};
+  auto calls = 0;
+  auto connection = tree.modificationSignal("v")->connect(
+      [&](const json11::Json &, const json11::Json &) { ++calls; },
+      Coalesce{10ms, {}, &timer});
+  tree.set("v", 1);
+  connection.disconnect();
+  check(timer.tick(later()) == 1, "the pending delivery still runs");
+  check(calls == 0, "changes pending at the disconnect are dropped");
+}
+
+int main() {
+  try {
+    firstOldLatestNew();
+    severalPaths();
+    disconnectWhilePending();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
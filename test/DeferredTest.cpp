@@ -0,0 +1,71 @@
+// Deferred dispatch of the slots after the tree lock has been released
+#include <otree/ObservableTree.h>
+
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                            otree::Path::KeyType, std::mutex>;
+using Object = json11::Json::object;
+
+void slotsRunUnlocked() {
+  auto tree = Tree{};
+  tree.setDispatchMode(DispatchMode::Deferred);
+  auto seen = std::vector<int>{};
+  auto subscribed = std::vector<Tree::SignalPtrType>{};
+  // reading and subscribing would deadlock under the tree lock
+  auto c1 = tree.modificationSignal("a")->connect(
+      [&](const json11::Json &, const json11::Json &newNode) {
+        check(tree.get("a") == newNode, "the slot reads the updated tree");
+        subscribed.push_back(tree.modificationSignal("b"));
+        seen.push_back(newNode.int_value());
+      });
+  tree.set(Object{{"a", 1}});
+  tree.set("a", 2);
+  check(seen == std::vector<int>{1, 2} && subscribed.size() == 2,
+        "without an executor the updating thread runs the slots");
+}
+
+void executorRunsBatchesInOrder() {
+  auto tree = Tree{};
+  auto posted = std::vector<std::function<void()>>{};
+  tree.setDispatchMode(DispatchMode::Deferred,
+                       [&posted](std::function<void()> work) {
+                         posted.push_back(std::move(work));
+                       });
+  auto seen = std::vector<int>{};
+  auto c1 = tree.modificationSignal("a")->connect(
+      [&seen](const json11::Json &, const json11::Json &newNode) {
+        seen.push_back(newNode.int_value());
+      });
+  tree.set(Object{{"a", 1}});
+  tree.set("a", 2);
+  tree.set("a", 3);
+  check(seen.empty(), "the slots wait for the executor");
+  check(posted.size() == 1, "one drain runs the batches posted meanwhile");
+  posted.front()();
+  check(seen == std::vector<int>{1, 2, 3},
+        "the batches run in the order of the updates");
+  tree.set("a", 4);
+  check(posted.size() == 2, "the next update posts a new drain");
+  posted.back()();
+  check(seen.back() == 4, "the new drain runs its batch");
+}
+
+int main() {
+  try {
+    slotsRunUnlocked();
+    executorRunsBatchesInOrder();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
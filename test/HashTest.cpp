@@ -0,0 +1,72 @@
+// Diffs of Node trees skipping the deep compares the cached hashes decide
+#include <otree/Node.h>
+
+#include <iostream>
+#include <string>
+
+#include "Check.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<Node, NodeTrait, InternedPath, InternedKey,
+                            std::mutex, MapIndex, CountingInstrumentation>;
+
+static_assert(detail::HasHash<NodeTrait, Node>::value,
+              "NodeTrait provides the hash hook");
+
+// An object of `size` children, built anew on each call
+Node makeBranch(const std::string &prefix, int size) {
+  auto branch = Node::object();
+  for (int i = 0; i < size; ++i) {
+    branch.set(prefix + std::to_string(i), i);
+  }
+  return branch;
+}
+
+void changedByHash() {
+  auto tree = Tree{};
+  auto root = Node::object();
+  root.set("config", Node{{"big", makeBranch("k", 1000)}, {"flag", 0}});
+  tree.set(root);
+  auto configChanges = 0;
+  auto bigChanges = 0;
+  auto c1 = tree.modificationSignal("config")->connect(
+      [&](const Node &, const Node &) { ++configChanges; });
+  auto c2 = tree.modificationSignal("config/big")->connect(
+      [&](const Node &, const Node &) { ++bigChanges; });
+  auto before = tree.stats();
+  // config/big stays shared with the old root, only the flag changes
+  NodeTrait::set(root, InternedPath{"config/flag"}, 1);
+  tree.set(root);
+  auto after = tree.stats();
+  check(configChanges == 1 && bigChanges == 0, "only config is notified");
+  check(after.equalCalls == before.equalCalls,
+        "the changed ancestor is decided by its hash, the shared subtree "
+        "by identity, without calling equal");
+}
+
+void equalHashesAreConfirmed() {
+  auto tree = Tree{};
+  tree.set(Node{{"big", makeBranch("k", 1000)}});
+  auto bigChanges = 0;
+  auto c = tree.modificationSignal("big")->connect(
+      [&](const Node &, const Node &) { ++bigChanges; });
+  auto before = tree.stats();
+  // equal but not shared, the hashes match and equal() confirms them
+  tree.set(Node{{"big", makeBranch("k", 1000)}});
+  auto after = tree.stats();
+  check(bigChanges == 0, "an equal subtree is not notified");
+  check(after.equalCalls - before.equalCalls == 1,
+        "the observed subtree is confirmed by equal");
+}
+
+int main() {
+  try {
+    changedByHash();
+    equalHashesAreConfirmed();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Subscription index policies: the flat index and its arena of levels
+#include <otree/ObservableTree.h>
+
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using FlatTree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                                otree::Path::KeyType, std::mutex, FlatIndex>;
+using Object = json11::Json::object;
+using Connection =
+    decltype(std::declval<FlatTree &>().modificationSignal("a")->connect(
+        nullptr));
+
+std::string leafPath(int i, int j) {
+  return "k" + std::to_string(i) + "/k" + std::to_string(j);
+}
+
+json11::Json document(int width, int value) {
+  auto root = Object{};
+  for (int i = 0; i < width; ++i) {
+    auto level = Object{};
+    for (int j = 0; j < width; ++j) {
+      level["k" + std::to_string(j)] = value;
+    }
+    root["k" + std::to_string(i)] = level;
+  }
+  return root;
+}
+
+std::vector<Connection> subscribe(FlatTree &tree, int width, int &notified) {
+  auto connections = std::vector<Connection>{};
+  for (int i = 0; i < width; ++i) {
+    for (int j = 0; j < width; ++j) {
+      connections.push_back(tree.modificationSignal(leafPath(i, j))
+                                ->connect([&notified](const json11::Json &,
+                                                      const json11::Json &) {
+                                  ++notified;
+                                }));
+    }
+  }
+  return connections;
+}
+
+void levelsAreReused() {
+  auto tree = FlatTree{};
+  auto notified = 0;
+  auto connections = subscribe(tree, 20, notified);
+  tree.set(document(20, 1));
+  check(notified == 400, "every observed leaf is notified");
+  for (auto &connection : connections) {
+    connection.disconnect();
+  }
+  auto pruned = tree.prune();
+  check(pruned.signals == 400 && pruned.entries == 420,
+        "prune releases the signals and the levels");
+  notified = 0;
+  connections = subscribe(tree, 20, notified);
+  tree.set(document(20, 2));
+  check(notified == 400, "levels created again from the arena work");
+}
+
+void parallelPrune() {
+  auto workers = std::vector<std::thread>{};
+  auto tree = FlatTree{};
+  tree.setParallelDiff({[&workers](std::function<void()> work) {
+                          workers.emplace_back(std::move(work));
+                        },
+                        3, 4});
+  auto notified = 0;
+  auto connections = subscribe(tree, 16, notified);
+  tree.set(document(16, 1));
+  for (auto &connection : connections) {
+    connection.disconnect();
+  }
+  tree.set(document(16, 2));
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  auto pruned = tree.pruneCounts();
+  check(workers.size() == 6 && pruned.signals == 256 &&
+            pruned.entries == 272 && tree.prune().entries == 0,
+        "the parallel diff released the levels of the unused subscriptions");
+}
+
+void connectionOutlivesTree() {
+  auto connection = std::optional<Connection>{};
+  {
+    auto tree = FlatTree{};
+    connection = tree.modificationSignal("a/b")->connect(
+        [](const json11::Json &, const json11::Json &) {});
+  }
+  connection->disconnect();
+}
+
+int main() {
+  try {
+    levelsAreReused();
+    parallelPrune();
+    connectionOutlivesTree();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
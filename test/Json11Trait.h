@@ -0,0 +1,156 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#include <iterator>
+#include <json11/json11.hpp>
+#include <string>
+#include <type_traits>
+
+namespace otree {
+
+struct Json11Trait {
+  using JsonType = json11::Json;
+  template <typename T, typename = void>
+  struct Impl;
+
+  static JsonType get(const JsonType &j, const Path &kp) {
+    JsonType jret = j;
+    for (const auto &key : kp.keys()) {
+      if (jret = jret[key]; jret.is_null()) {
+        break;
+      }
+    }
+    return jret;
+  }
+
+  // Json values are immutable, the objects along the path are rebuilt
+  static void set(JsonType &j, const Path &kp, const JsonType &jvalue) {
+    j = with(j, kp.keys().begin(), kp.keys().end(), jvalue);
+  }
+
+  // Objects along the path are rebuilt, unless nothing is removed
+  static void erase(JsonType &j, const Path &kp) {
+    if (!kp.keys().empty()) {
+      j = without(j, kp.keys().begin(), kp.keys().end());
+    }
+  }
+
+  static bool isObject(const JsonType &j) { return j.is_object(); }
+
+  static JsonType get(const JsonType &j, const Path::KeyType &key) {
+    return j[key];
+  }
+
+  static const JsonType *getChild(const JsonType &j,
+                                  const Path::KeyType &key) {
+    const auto &child = j[key];
+    return child.is_null() ? nullptr : &child;
+  }
+
+  static bool equal(const JsonType &j1, const JsonType &j2) { return j1 == j2; }
+
+  // Json values sharing a payload expose the same item storage
+  static bool identical(const JsonType &j1, const JsonType &j2) {
+    if (j1.type() != j2.type()) {
+      return false;
+    }
+    switch (j1.type()) {
+      case JsonType::NUL:
+        return true;
+      case JsonType::NUMBER:
+        return j1.number_value() == j2.number_value();
+      case JsonType::BOOL:
+        return j1.bool_value() == j2.bool_value();
+      case JsonType::STRING:
+        return &j1.string_value() == &j2.string_value();
+      case JsonType::ARRAY:
+        return &j1.array_items() == &j2.array_items();
+      case JsonType::OBJECT:
+        return &j1.object_items() == &j2.object_items();
+    }
+    return false;
+  }
+
+  static bool empty(const JsonType &j) { return j.is_null(); }
+
+  // Object items are a std::map, visited in key order
+  static constexpr bool sortedChildren = true;
+
+  template <class Fn>
+  static void forEachChild(const JsonType &j, Fn &&fn) {
+    for (const auto &[key, child] : j.object_items()) {
+      fn(key, child);
+    }
+  }
+
+  static size_t size(const JsonType &j) { return j.object_items().size(); }
+
+  template <typename T, typename = bool>
+  static T get(const JsonType &j, const Path &kp) {
+    return Impl<T>::get(Json11Trait::get(j, kp));
+  }
+
+  template <class RawType, class Type>
+  using IsTypeOf = std::enable_if_t<
+      std::is_same_v<RawType, std::remove_cv_t<std::remove_reference_t<Type>>>,
+      void>;
+
+  template <class Int>
+  struct Impl<Int, IsTypeOf<int, Int>> {
+    static int get(const JsonType &j) { return j.int_value(); }
+  };
+  template <class Double>
+  struct Impl<Double, IsTypeOf<double, Double>> {
+    static double get(const JsonType &j) { return j.number_value(); }
+  };
+  template <class String>
+  struct Impl<String, IsTypeOf<std::string, String>> {
+    static String get(const JsonType &j) { return j.string_value(); }
+  };
+
+  template <class Bool>
+  struct Impl<Bool, IsTypeOf<bool, Bool>> {
+    static bool get(const JsonType &j) { return j.bool_value(); }
+  };
+
+  template <class Array>
+  struct Impl<Array, IsTypeOf<JsonType::array, Array>> {
+    static JsonType::array get(const JsonType &j) { return j.array_items(); }
+  };
+
+  template <class JsonObject>
+  struct Impl<JsonObject, IsTypeOf<JsonType::object, JsonObject>> {
+    static JsonObject get(const JsonType &j) { return j.object_items(); }
+  };
+
+ private:
+  template <class KeyIt>
+  static JsonType with(const JsonType &j, KeyIt first, KeyIt last,
+                       const JsonType &jvalue) {
+    if (first == last) {
+      return jvalue;
+    }
+    auto items = j.object_items();
+    auto &item = items[*first];
+    item = with(item, std::next(first), last, jvalue);
+    return items;
+  }
+
+  template <class KeyIt>
+  static JsonType without(const JsonType &j, KeyIt first, KeyIt last) {
+    auto child = j.object_items().find(*first);
+    if (child == j.object_items().end()) {
+      return j;
+    }
+    auto items = j.object_items();
+    if (std::next(first) == last) {
+      items.erase(*first);
+    } else {
+      items[*first] = without(child->second, std::next(first), last);
+    }
+    return items;
+  }
+};
+
+}  // namespace otree
@@ -0,0 +1,186 @@
+// Merge patches compared with set() of the patched root
+#include <otree/ObservableTree.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+using ConnectionType =
+    decltype(std::declval<Tree &>().modificationSignal("")->connect(nullptr));
+
+// Compact form independent of the spacing of Json::dump()
+std::string format(const json11::Json &node) {
+  if (!node.is_object()) {
+    return node.dump();
+  }
+  auto formatted = std::string{"{"};
+  for (const auto &[key, child] : node.object_items()) {
+    formatted += (formatted.size() > 1 ? "," : "") + key + ":" + format(child);
+  }
+  return formatted + "}";
+}
+
+// RFC 7386
+json11::Json mergePatch(const json11::Json &target,
+                        const json11::Json &patch) {
+  if (!patch.is_object()) {
+    return patch;
+  }
+  auto merged = target.is_object() ? target.object_items() : Object{};
+  for (const auto &[key, child] : patch.object_items()) {
+    if (child.is_null()) {
+      merged.erase(key);
+    } else {
+      merged[key] = mergePatch(merged[key], child);
+    }
+  }
+  return merged;
+}
+
+// Paths of the literal keys k0 to k2 and of wildcards, up to three deep
+std::vector<std::string> subscriptionPaths() {
+  auto paths = std::vector<std::string>{};
+  for (auto first : {"k0", "k1", "*"}) {
+    paths.push_back(first);
+    for (auto second : {"k0", "k2", "**"}) {
+      paths.push_back(std::string{first} + "/" + second);
+      paths.push_back(std::string{first} + "/" + second + "/k1");
+    }
+  }
+  return paths;
+}
+
+// Records "subscription@matched path:old>new" of each notification
+std::vector<ConnectionType> observe(Tree &tree,
+                                    std::vector<std::string> &notified) {
+  auto connections = std::vector<ConnectionType>{};
+  for (const auto &path : subscriptionPaths()) {
+    connections.push_back(tree.modificationSignal(path)->connect(
+        [&notified, path](const Path &at, const json11::Json &oldNode,
+                          const json11::Json &newNode) {
+          notified.push_back(path + "@" + at.toString() + ":" +
+                             format(oldNode) + ">" + format(newNode));
+        }));
+  }
+  return connections;
+}
+
+class Comparison {
+ public:
+  explicit Comparison(const json11::Json &root) {
+    merging_.set(root);
+    setting_.set(root);
+  }
+
+  // Merges `patch` into one tree and sets the patched root of the other
+  void merge(const json11::Json &patch, const std::string &what) {
+    mergeNotified_.clear();
+    setNotified_.clear();
+    setting_.set(mergePatch(setting_.get(), patch));
+    merging_.merge(patch);
+    std::sort(mergeNotified_.begin(), mergeNotified_.end());
+    std::sort(setNotified_.begin(), setNotified_.end());
+    check(merging_.get() == setting_.get(), what + ": the roots match");
+    check(mergeNotified_ == setNotified_, what + ": the notifications match");
+  }
+
+  const std::vector<std::string> &notified() const { return mergeNotified_; }
+
+ private:
+  Tree merging_;
+  Tree setting_;
+  std::vector<std::string> mergeNotified_;
+  std::vector<std::string> setNotified_;
+  std::vector<ConnectionType> mergeConnections_ =
+      observe(merging_, mergeNotified_);
+  std::vector<ConnectionType> setConnections_ = observe(setting_, setNotified_);
+};
+
+void nullDeletes() {
+  auto comparison = Comparison{Object{{"k0", Object{{"k0", 1}, {"k2", 2}}}}};
+  comparison.merge(Object{{"k0", Object{{"k2", nullptr}}}}, "null deletion");
+  check(std::count(comparison.notified().begin(), comparison.notified().end(),
+                   "k0/k2@:2>null") == 1,
+        "the deleted path is notified once");
+  comparison.merge(Object{{"k1", nullptr}}, "deleting a missing key");
+  check(comparison.notified().empty(), "nothing changed");
+}
+
+void scalarReplacedByObject() {
+  auto comparison = Comparison{Object{{"k0", 1}}};
+  comparison.merge(Object{{"k0", Object{{"k2", Object{{"k1", 3}}}}}},
+                   "scalar to object");
+  check(std::count(comparison.notified().begin(), comparison.notified().end(),
+                   "k0/k2/k1@:null>3") == 1,
+        "the added descendants are notified");
+  comparison.merge(Object{{"k0", 2}}, "object to scalar");
+  comparison.merge(Object{{"k0", Object{{"k0", nullptr}, {"k2", 4}}}},
+                   "nulls of a patch replacing a scalar");
+}
+
+void wildcards() {
+  auto comparison = Comparison{Object{{"k1", Object{{"k0", 1}}}}};
+  comparison.merge(
+      Object{{"k1", Object{{"k0", 2}, {"k2", Object{{"k1", 3}}}}}},
+      "wildcard matches");
+  auto &notified = comparison.notified();
+  for (const auto *expected :
+       {"*@k1:{k0:1}>{k0:2,k2:{k1:3}}", "k1/**@k1/k0:1>2",
+        "k1/**@k1/k2:null>{k1:3}", "k1/**@k1/k2/k1:null>3",
+        "*/**/k1@k1/k2/k1:null>3"}) {
+    check(std::count(notified.begin(), notified.end(), expected) == 1,
+          std::string{"notified once: "} + expected);
+  }
+}
+
+json11::Json randomNode(std::mt19937 &random, int depth, bool patch) {
+  auto pick = std::uniform_int_distribution<int>{0, 9};
+  auto kind = pick(random);
+  if (depth == 0 || kind < 3) {
+    if (patch && kind == 0) {
+      return nullptr;
+    }
+    return pick(random) % 3;
+  }
+  auto object = Object{};
+  auto children = pick(random) % 4;
+  for (int i = 0; i < children; ++i) {
+    object["k" + std::to_string(pick(random) % 3)] =
+        randomNode(random, depth - 1, patch);
+  }
+  return object;
+}
+
+void randomized() {
+  auto random = std::mt19937{7};
+  for (int round = 0; round < 100; ++round) {
+    auto comparison = Comparison{randomNode(random, 4, false)};
+    for (int step = 0; step < 20; ++step) {
+      comparison.merge(randomNode(random, 4, true),
+                       "round " + std::to_string(round) + " step " +
+                           std::to_string(step));
+    }
+  }
+}
+
+int main() {
+  try {
+    nullDeletes();
+    scalarReplacedByObject();
+    wildcards();
+    randomized();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Parallel diffs of large subscription levels against serial ones
+#include <otree/ObservableTree.h>
+
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                            otree::Path::KeyType, std::mutex>;
+using Object = json11::Json::object;
+using Connection =
+    decltype(std::declval<Tree &>().modificationSignal("a")->connect(nullptr));
+
+// Runs posted work on threads joined by join()
+class Workers {
+ public:
+  Executor executor() {
+    return [this](std::function<void()> work) {
+      LockGuard lock(mutex_);
+      threads_.emplace_back(std::move(work));
+    };
+  }
+
+  size_t join() {
+    LockGuard lock(mutex_);
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+    return std::exchange(threads_, {}).size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::thread> threads_;
+};
+
+// Branches k<i> holding leaves l<j>, whose values depend on `round`
+json11::Json document(int branches, int round) {
+  auto root = Object{};
+  for (int i = 0; i < branches; ++i) {
+    auto branch = Object{};
+    for (int j = 0; j < 3; ++j) {
+      branch["l" + std::to_string(j)] = (i * 7 + j * 3 + round) % 5;
+    }
+    root["k" + std::to_string(i)] = branch;
+  }
+  return root;
+}
+
+// Records "path:old>new" in the order the slots are called
+std::vector<Connection> observe(Tree &tree, int branches,
+                                std::vector<std::string> &notified) {
+  auto connections = std::vector<Connection>{};
+  for (int i = 0; i < branches; ++i) {
+    for (const auto &path : {"k" + std::to_string(i),
+                             "k" + std::to_string(i) + "/l1"}) {
+      connections.push_back(tree.modificationSignal(path)->connect(
+          [&notified, path](const json11::Json &oldNode,
+                            const json11::Json &newNode) {
+            notified.push_back(path + ":" + oldNode.dump() + ">" +
+                               newNode.dump());
+          }));
+    }
+  }
+  return connections;
+}
+
+void sameNotifications() {
+  auto workers = Workers{};
+  auto parallel = Tree{};
+  auto serial = Tree{};
+  parallel.setParallelDiff({workers.executor(), 3, 16});
+  auto parallelNotified = std::vector<std::string>{};
+  auto serialNotified = std::vector<std::string>{};
+  auto c1 = observe(parallel, 64, parallelNotified);
+  auto c2 = observe(serial, 64, serialNotified);
+  for (int round = 0; round < 10; ++round) {
+    auto parallelChanges = ChangeSet<Tree>{};
+    auto serialChanges = ChangeSet<Tree>{};
+    parallel.set(document(64, round), parallelChanges);
+    serial.set(document(64, round), serialChanges);
+    check(parallelChanges.size() == serialChanges.size(),
+          "parallel diffs record the changes of serial ones");
+  }
+  check(workers.join() > 0, "the diffs ran on the executor");
+  check(!serialNotified.empty() && parallelNotified == serialNotified,
+        "slots are called in the order of a serial diff");
+}
+
+void smallLevelsAreSerial() {
+  auto workers = Workers{};
+  auto tree = Tree{};
+  tree.setParallelDiff({workers.executor(), 3, 64});
+  auto notified = std::vector<std::string>{};
+  auto connections = observe(tree, 32, notified);
+  tree.set(document(32, 0));
+  tree.set(document(32, 1));
+  check(workers.join() == 0 && !notified.empty(),
+        "levels below minEntries are diffed serially");
+}
+
+int main() {
+  try {
+    sameNotifications();
+    smallLevelsAreSerial();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
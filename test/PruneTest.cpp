@@ -0,0 +1,74 @@
+// Release of the subscriptions of dropped connections
+#include <otree/ObservableTree.h>
+
+#include <iostream>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+void slot(const json11::Json &, const json11::Json &) {}
+
+void diffsPrune() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"b", Object{{"c", 1}}}}}});
+  tree.modificationSignal("a/b/c")->connect(slot).disconnect();
+  tree.set(Object{{"a", Object{{"b", Object{{"c", 2}}}}}});
+  auto pruned = tree.pruneCounts();
+  check(pruned.signals == 1 && pruned.entries == 3,
+        "a diff releases the subscriptions of the subtrees it visits");
+  pruned = tree.prune();
+  check(pruned.signals == 0 && pruned.entries == 0,
+        "prune() finds nothing left");
+}
+
+void pruneSweepsUnchanged() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}, {"x", Object{{"y", 1}}}});
+  auto kept = tree.modificationSignal("x/z");
+  tree.modificationSignal("x/y")->connect(slot).disconnect();
+  tree.set("a", 2);
+  check(tree.pruneCounts().signals == 0,
+        "subscriptions of unchanged subtrees are not visited by diffs");
+  auto pruned = tree.prune();
+  check(pruned.signals == 1 && pruned.entries == 1,
+        "prune() sweeps the whole index, held signals stay");
+  check(tree.pruneCounts().signals == 1, "pruneCounts() sums the passes");
+  auto notified = 0;
+  auto connection = kept->connect(
+      [&notified](const json11::Json &, const json11::Json &) { ++notified; });
+  tree.set("x/z", 1);
+  check(notified == 1, "a held signal still notifies once connected");
+}
+
+void handlesFollowPrune() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}});
+  auto handle = tree.resolve("a");
+  tree.modificationSignal("a")->connect(slot).disconnect();
+  tree.prune();
+  tree.set(handle, 2);
+  check(tree.get(handle).int_value() == 2,
+        "a path handle resolved before prune() still works");
+  auto notified = 0;
+  auto connection = tree.modificationSignal("a")->connect(
+      [&notified](const json11::Json &, const json11::Json &) { ++notified; });
+  tree.set(handle, 3);
+  check(notified == 1, "a path handle notifies subscriptions made after it");
+}
+
+int main() {
+  try {
+    diffsPrune();
+    pruneSweepsUnchanged();
+    handlesFollowPrune();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
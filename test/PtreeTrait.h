@@ -0,0 +1,145 @@
+#pragma once
+
+#include <otree/ObservableTree.h>
+
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <memory>
+#include <vector>
+
+namespace pt = boost::property_tree;
+
+namespace otree {
+class PtreeTrait {
+ public:
+  using NodeType = pt::ptree;
+  using PathType = pt::ptree::path_type;
+  using KeyType = pt::ptree::key_type;
+
+  static NodeType get(const NodeType &node, const PathType &path) {
+    try {
+      return node.get_child(path);
+    } catch (...) {
+      return {};
+    }
+  }
+
+  static void set(NodeType &node, const PathType &path, const NodeType &value) {
+    node.put_child(path, value);
+  }
+
+  static NodeType *locate(NodeType &node, const PathType &path) {
+    auto child = node.get_child_optional(path);
+    return child ? &*child : nullptr;
+  }
+
+  static NodeType get(const NodeType &node, const KeyType &key) {
+    try {
+      return node.get_child(key);
+    } catch (...) {
+      return {};
+    }
+  }
+
+  static const NodeType *getChild(const NodeType &node, const KeyType &key) {
+    auto it = node.find(key);
+    return it != node.not_found() ? &it->second : nullptr;
+  }
+
+  static bool equal(const NodeType &node1, const NodeType &node2) {
+    return node1 == node2;
+  }
+
+  static bool empty(const NodeType &j) { return j.begin() == j.end(); }
+
+  template <class Fn>
+  static void forEachChild(const NodeType &node, Fn &&fn) {
+    for (const auto &[key, child] : node) {
+      fn(key, child);
+    }
+  }
+
+  static size_t size(const NodeType &node) { return node.size(); }
+
+  static PathType makePath(const std::vector<KeyType> &keys) {
+    return PathType{otree::Path{keys}.toString(), '/'};
+  }
+
+  // Values that do not convert read as T{}
+  template <typename T>
+  struct Impl {
+    static T get(const NodeType &node) { return node.get_value<T>(T{}); }
+  };
+
+  template <typename T>
+  static T get(const NodeType &node, const PathType &path) {
+    return Impl<T>::get(get(node, path));
+  }
+};
+
+class PPathIter {
+  using PathImpl = otree::Path;
+  using BaseIt = otree::Path::iterator;
+  std::shared_ptr<PathImpl> p;
+  int index = -1;
+
+ public:
+  using ValueType = PathImpl::KeyType;
+
+  PPathIter(const PtreeTrait::PathType &ppath) : p{new PathImpl{ppath.dump()}} {
+    if (!p->keys().empty()) {
+      index = 0;
+    }
+  }
+
+  PPathIter() = default;
+
+  bool operator==(const PPathIter &otherIt) const {
+    return (p == otherIt.p && index == otherIt.index) ||
+           ((otherIt.index == -1) && (index == -1));
+  }
+
+  bool operator!=(const PPathIter &other) const { return !(*this == other); }
+
+  PPathIter &operator++() {
+    if (p && index != -1) {
+      if (static_cast<size_t>(index) < p->keys().size() - 1) {
+        ++index;
+      } else {
+        index = -1;
+      }
+    }
+    return *this;
+  }
+
+  PPathIter operator++(int) {
+    auto it = *this;
+    if (p && index != -1) {
+      if (static_cast<size_t>(index) < p->keys().size() - 1) {
+        ++index;
+      } else {
+        index = -1;
+      }
+    }
+    return it;
+  }
+
+  const ValueType &operator*() const { return p->keys()[index]; }
+};
+
+}  // namespace otree
+
+// Found through ADL on the path type, otree::SignalMgr looks them up
+// unqualified from inside a template
+namespace boost::property_tree {
+
+inline auto begin(const otree::PtreeTrait::PathType &p) {
+  return otree::PPathIter{p};
+}
+
+inline auto end(const otree::PtreeTrait::PathType &) {
+  return otree::PPathIter{};
+}
+
+}  // namespace boost::property_tree
@@ -0,0 +1,65 @@
+// Reads of the live nodes under the tree lock: visit() and read()
+#include <otree/ObservableTree.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                            otree::Path::KeyType, std::mutex>;
+using Object = json11::Json::object;
+
+void visits() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"b", 1}}}});
+  auto size = tree.visit(
+      [](const json11::Json &root) { return root.object_items().size(); });
+  check(size == 1, "visit() returns the result of the function");
+  auto intValue = [](const json11::Json &node) { return node.int_value(); };
+  check(tree.visit("a/b", intValue) == 1,
+        "visit(path) passes the node at the path");
+  auto isNull = [](const json11::Json &node) { return node.is_null(); };
+  check(tree.visit("a/c", isNull), "missing paths pass the empty node");
+  const json11::Json *visited = nullptr;
+  tree.visit("a", [&visited](const json11::Json &node) { visited = &node; });
+  check(visited == &tree.read().get("a"), "the visited node is the live one");
+}
+
+void viewsHoldTheLock() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}});
+  auto written = std::atomic<bool>{false};
+  auto writer = std::thread{};
+  {
+    auto view = tree.read();
+    const auto &a = view.get("a");
+    writer = std::thread{[&] {
+      tree.set("a", 2);
+      written = true;
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    check(!written && a.int_value() == 1 && view.get().is_object(),
+          "writers wait while a view is alive");
+  }
+  writer.join();
+  check(written && tree.get("a").int_value() == 2,
+        "the writer proceeds once the view is gone");
+}
+
+int main() {
+  try {
+    visits();
+    viewsHoldTheLock();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+// Trees sharded by top-level key
+#include <otree/ShardedObservableTree.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ShardedObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+Object branches(int count, int value) {
+  auto root = Object{};
+  for (int i = 0; i < count; ++i) {
+    root["k" + std::to_string(i)] = Object{{"v", value}};
+  }
+  return root;
+}
+
+void rootUpdates() {
+  auto tree = Tree{4};
+  auto notified = std::vector<int>(8);
+  auto connections = std::vector<decltype(
+      tree.modificationSignal("k0/v")->connect(nullptr))>{};
+  for (int i = 0; i < 8; ++i) {
+    connections.push_back(
+        tree.modificationSignal("k" + std::to_string(i) + "/v")
+            ->connect([&notified, i](const json11::Json &,
+                                     const json11::Json &) { ++notified[i]; }));
+  }
+  tree.set(branches(8, 1));
+  check(tree.get() == json11::Json{branches(8, 1)},
+        "the root is the union of the shard roots");
+  check(notified == std::vector<int>(8, 1), "each shard notifies its keys");
+  tree.set(branches(6, 1));
+  check(notified == std::vector<int>{1, 1, 1, 1, 1, 1, 2, 2},
+        "branches missing from a root update are erased");
+  check(tree.get() == json11::Json{branches(6, 1)}, "the root drops them");
+}
+
+void pathUpdates() {
+  auto tree = Tree{4};
+  tree.set(branches(4, 1));
+  auto seen = 0;
+  auto connection = tree.modificationSignal("k1/v")->connect(
+      [&seen](const json11::Json &, const json11::Json &newNode) {
+        seen = newNode.int_value();
+      });
+  auto version = tree.version("k1/v");
+  tree.set("k2/v", 5);
+  check(seen == 0 && tree.version("k1/v") == version,
+        "writes of other branches do not touch the path");
+  tree.set("k1/v", 7);
+  check(seen == 7 && tree.get("k1/v").int_value() == 7 &&
+            tree.version("k1/v") > version,
+        "a path update goes to the shard of its first key");
+  auto visited = tree.visit(
+      "k1", [](const json11::Json &node) { return node["v"].int_value(); });
+  check(visited == 7, "visit() reads the live node of the shard");
+  auto thrown = false;
+  try {
+    tree.modificationSignal("*/v");
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  check(thrown, "top-level wildcards are rejected");
+}
+
+void concurrentWriters() {
+  auto tree = Tree{8};
+  tree.set(branches(8, 0));
+  auto writers = std::vector<std::thread>{};
+  for (int writer = 0; writer < 8; ++writer) {
+    writers.emplace_back([&tree, writer] {
+      auto path = "k" + std::to_string(writer) + "/v";
+      for (int i = 1; i <= 1000; ++i) {
+        tree.set(path, i);
+      }
+    });
+  }
+  for (auto &thread : writers) {
+    thread.join();
+  }
+  check(tree.get() == json11::Json{branches(8, 1000)},
+        "writers of different branches do not lose updates");
+}
+
+int main() {
+  try {
+    rootUpdates();
+    pathUpdates();
+    concurrentWriters();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
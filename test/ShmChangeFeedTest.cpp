@@ -0,0 +1,200 @@
+// Publisher and replica trees of a shared memory feed in one process
+#include <otree/ShmChangeFeed.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                            otree::Path::KeyType, std::mutex>;
+
+struct JsonCodec {
+  static std::string encode(const json11::Json &node) { return node.dump(); }
+  static json11::Json decode(std::string_view bytes) {
+    auto error = std::string{};
+    return json11::Json::parse(std::string{bytes}, error);
+  }
+};
+
+using Object = json11::Json::object;
+using Publisher = ShmFeedPublisher<Tree, JsonCodec>;
+using Replica = ShmFeedReplica<Tree, JsonCodec>;
+
+// Unique per process, tests may run in parallel
+std::string feedName(const std::string &test) {
+  return "/otree-" + test + "-" + std::to_string(::getpid());
+}
+
+json11::Json parse(const std::string &text) {
+  auto error = std::string{};
+  return json11::Json::parse(text, error);
+}
+
+void roundTrip() {
+  auto source = Tree{};
+  auto copy = Tree{};
+  auto publisher = Publisher{source, feedName("round-trip"), 4096};
+  auto replica = Replica{copy, feedName("round-trip")};
+  check(!replica.synced() && replica.poll() == 0,
+        "the replica waits for its snapshot");
+  publisher.serveSnapshots();
+  check(replica.poll() == 1 && replica.synced(), "the snapshot syncs");
+  auto observe = [](Tree &tree, std::vector<std::string> &paths) {
+    return tree.modificationSignal("config/*")->connect(
+        [&paths](const Path &path, const json11::Json &,
+                 const json11::Json &) { paths.push_back(path.toString()); });
+  };
+  auto sourcePaths = std::vector<std::string>{};
+  auto copyPaths = std::vector<std::string>{};
+  auto c1 = observe(source, sourcePaths);
+  auto c2 = observe(copy, copyPaths);
+  publisher.set(parse(R"({"config": {"a": 1, "b": {"c": 2}}})"));
+  publisher.set("config/b/c", 3);
+  publisher.merge(parse(R"({"config": {"a": null, "d": 4}})"));
+  check(replica.poll() == 3, "one frame per update");
+  check(copy.get() == source.get(), "the replica holds the source root");
+  check(copy.get() == parse(R"({"config": {"b": {"c": 3}, "d": 4}})"),
+        "sets, erases and merges are applied");
+  std::sort(sourcePaths.begin(), sourcePaths.end());
+  std::sort(copyPaths.begin(), copyPaths.end());
+  check(!copyPaths.empty() && copyPaths == sourcePaths,
+        "the replica notifies the changes of the source");
+}
+
+void overrunResyncs() {
+  auto source = Tree{};
+  auto copy = Tree{};
+  auto publisher = Publisher{source, feedName("overrun"), 1024};
+  auto replica = Replica{copy, feedName("overrun")};
+  publisher.serveSnapshots();
+  replica.poll();
+  for (int i = 0; i < 200; ++i) {
+    publisher.set("value", i);
+  }
+  replica.poll();
+  check(replica.overruns() == 1 && !replica.synced(),
+        "a replica a ring behind loses its place");
+  publisher.serveSnapshots();
+  check(replica.poll() == 1 && replica.synced() && copy.get() == source.get(),
+        "the snapshot resyncs the replica");
+  publisher.set("value", 200);
+  check(replica.poll() == 1 && copy.get("value").int_value() == 200,
+        "updates apply again after the resync");
+}
+
+void oversizeUpdates() {
+  auto source = Tree{};
+  auto copy = Tree{};
+  auto publisher = Publisher{source, feedName("oversize"), 1024};
+  auto replica = Replica{copy, feedName("oversize")};
+  publisher.serveSnapshots();
+  replica.poll();
+  publisher.set("small", 1);
+  auto thrown = [](auto &&update) {
+    try {
+      update();
+    } catch (const std::length_error &) {
+      return true;
+    }
+    return false;
+  };
+  auto huge = json11::Json{std::string(1000, 'x')};
+  check(thrown([&] { publisher.set("huge", huge); }) &&
+            thrown([&] { publisher.merge(Object{{"huge", huge}}); }) &&
+            thrown([&] { publisher.set(Object{{"huge", huge}}); }),
+        "updates beyond the frame limit throw");
+  check(source.get() == parse(R"({"small": 1})"),
+        "updates that throw leave the tree unchanged");
+  publisher.set("small", 2);
+  check(replica.poll() == 2 && copy.get() == source.get(),
+        "the replica stays in sync");
+}
+
+void largeRoots() {
+  auto source = Tree{};
+  auto copy = Tree{};
+  auto publisher = Publisher{source, feedName("large-root"), 1024};
+  auto replica = Replica{copy, feedName("large-root")};
+  publisher.serveSnapshots();
+  replica.poll();
+  auto large = Object{{"a", std::string(300, 'a')},
+                      {"b", std::string(300, 'b')}};
+  publisher.set(large);
+  check(replica.poll() == 1 && copy.get() == source.get(),
+        "a root of more than half the ring is sent in parts");
+  large["a"] = std::string(300, 'c');
+  large["b"] = std::string(300, 'd');
+  publisher.set(large);
+  check(replica.poll() == 1 && copy.get() == source.get(),
+        "changes beyond half the ring are sent in parts");
+  auto late = Tree{};
+  auto lateReplica = Replica{late, feedName("large-root")};
+  publisher.serveSnapshots();
+  check(lateReplica.poll() == 1 && late.get() == source.get(),
+        "snapshots of large roots are sent in parts");
+  check(replica.poll() == 0, "synced replicas skip the snapshot");
+  publisher.set("a", std::string(300, 'e'));
+  publisher.set("b", std::string(300, 'e'));
+  publisher.set("c", std::string(300, 'e'));
+  auto grown = Tree{};
+  auto grownReplica = Replica{grown, feedName("large-root")};
+  auto thrown = false;
+  try {
+    publisher.serveSnapshots();
+  } catch (const std::length_error &) {
+    thrown = true;
+  }
+  check(thrown && grownReplica.poll() == 0 && !grownReplica.synced(),
+        "roots beyond the frame limit are not served");
+  publisher.set("c", 0);
+  check(grownReplica.poll() == 1 && grown.get() == source.get(),
+        "the request is served once the root fits again");
+}
+
+void concurrentPublishers() {
+  auto source = Tree{};
+  auto copy = Tree{};
+  auto publisher = Publisher{source, feedName("concurrent")};
+  auto replica = Replica{copy, feedName("concurrent")};
+  publisher.serveSnapshots();
+  replica.poll();
+  auto writers = std::vector<std::thread>{};
+  for (int writer = 0; writer < 4; ++writer) {
+    writers.emplace_back([&publisher, writer] {
+      for (int i = 0; i < 500; ++i) {
+        publisher.set("w" + std::to_string(writer), i);
+      }
+    });
+  }
+  for (auto &thread : writers) {
+    thread.join();
+  }
+  check(replica.poll() == 2000 && replica.overruns() == 0,
+        "the frames of every writer are published");
+  check(copy.get() == source.get(), "frames are in the order of the updates");
+}
+
+int main() {
+  try {
+    roundTrip();
+    overrunResyncs();
+    oversizeUpdates();
+    largeRoots();
+    concurrentPublishers();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Slots connected and disconnected while their signal dispatches
+#include <otree/ObservableTree.h>
+
+#include <array>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+using Connection =
+    decltype(std::declval<Tree &>().modificationSignal("a")->connect(nullptr));
+
+void disconnectDuringDispatch() {
+  auto tree = Tree{};
+  auto signal = tree.modificationSignal("a");
+  auto calls = std::vector<std::string>{};
+  auto connections = std::vector<std::optional<Connection>>(3);
+  connections[0] = signal->connect(
+      [&](const json11::Json &, const json11::Json &) {
+        calls.push_back("first");
+        connections[0]->disconnect();
+        connections[2]->disconnect();
+      });
+  connections[1] = signal->connect(
+      [&](const json11::Json &, const json11::Json &) {
+        calls.push_back("second");
+      });
+  connections[2] = signal->connect(
+      [&](const json11::Json &, const json11::Json &) {
+        calls.push_back("third");
+      });
+  tree.set(Object{{"a", 1}});
+  check(calls == std::vector<std::string>{"first", "second"},
+        "slots disconnected by a slot are not called any more");
+  calls.clear();
+  tree.set("a", 2);
+  check(calls == std::vector<std::string>{"second"},
+        "a slot that disconnected itself is gone");
+}
+
+void connectDuringDispatch() {
+  auto tree = Tree{};
+  auto signal = tree.modificationSignal("a");
+  auto calls = std::vector<std::string>{};
+  auto added = std::vector<Connection>{};
+  auto first = signal->connect(
+      [&](const json11::Json &, const json11::Json &) {
+        calls.push_back("first");
+        if (added.empty()) {
+          added.push_back(signal->connect(
+              [&](const json11::Json &, const json11::Json &) {
+                calls.push_back("added");
+              }));
+        }
+      });
+  tree.set(Object{{"a", 1}});
+  check(calls == std::vector<std::string>{"first"},
+        "a slot connected during the dispatch waits for the next one");
+  calls.clear();
+  tree.set("a", 2);
+  check(calls == std::vector<std::string>{"first", "added"},
+        "the slot connected by the single slot is kept");
+  first.disconnect();
+  added.front().disconnect();
+  calls.clear();
+  tree.set("a", 3);
+  check(calls.empty(), "all slots are disconnected");
+}
+
+void largeCallables() {
+  auto tree = Tree{};
+  auto payload = std::array<int, 64>{};
+  payload.back() = 7;
+  auto seen = 0;
+  auto connection = tree.modificationSignal("a")->connect(
+      [payload, &seen](const json11::Json &, const json11::Json &) {
+        seen = payload.back();
+      });
+  tree.set(Object{{"a", 1}});
+  check(seen == 7, "callables beyond the inline buffer are called");
+}
+
+int main() {
+  try {
+    disconnectDuringDispatch();
+    connectDuringDispatch();
+    largeCallables();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,61 @@
+// Lock-free snapshot reads of the published root
+#include <otree/ObservableTree.h>
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <mutex>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait, otree::Path,
+                            otree::Path::KeyType, std::mutex>;
+using Object = json11::Json::object;
+
+void immutableRoots() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}});
+  check(tree.snapshot().get("a").int_value() == 1,
+        "snapshots work without enableSnapshots()");
+  tree.enableSnapshots();
+  auto first = tree.snapshot();
+  tree.set("a", 2);
+  auto second = tree.snapshot();
+  check(first.get("a").int_value() == 1, "a snapshot keeps its root");
+  check(second.get("a").int_value() == 2, "updates publish a new root");
+  check(&tree.snapshot().get() == &second.get(),
+        "reads between updates share the published root");
+}
+
+void publishedByUpdates() {
+  auto tree = Tree{};
+  tree.enableSnapshots();
+  tree.set(Object{{"a", 1}});
+  tree.set("a", 2);
+  auto reader = std::future<json11::Json>{};
+  auto ready = false;
+  {
+    // the reader cannot take the tree lock held by the view
+    auto view = tree.read();
+    reader = std::async(std::launch::async,
+                        [&tree] { return tree.snapshot().get("a"); });
+    ready = reader.wait_for(std::chrono::seconds(5)) ==
+            std::future_status::ready;
+  }
+  check(ready && reader.get().int_value() == 2,
+        "shared roots are published by the update, not by the reader");
+}
+
+int main() {
+  try {
+    immutableRoots();
+    publishedByUpdates();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Path updates batched by transactions into one diff and notify pass
+#include <otree/ObservableTree.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+// Records "old>new" of the int values notified to the slots of `path`
+auto observe(Tree &tree, const std::string &path,
+             std::vector<std::string> &notified) {
+  return tree.modificationSignal(path)->connect(
+      [&notified](const json11::Json &oldNode, const json11::Json &newNode) {
+        notified.push_back(oldNode.dump() + ">" + newNode.dump());
+      });
+}
+
+void onePass() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"b", 1}, {"c", 2}}}, {"d", 3}});
+  auto parent = std::vector<std::string>{};
+  auto b = std::vector<std::string>{};
+  auto d = std::vector<std::string>{};
+  auto c1 = tree.modificationSignal("a")->connect(
+      [&parent](const json11::Json &, const json11::Json &) {
+        parent.push_back("a");
+      });
+  auto c2 = observe(tree, "a/b", b);
+  auto c3 = observe(tree, "d", d);
+  auto version = tree.version();
+  auto transaction = tree.begin();
+  transaction.set("a/b", 10);
+  transaction.set("a/c", 20);
+  transaction.set("a/b", 11);
+  transaction.erase("d");
+  check(tree.get("a/b").int_value() == 1, "writes wait for the commit");
+  transaction.commit();
+  check(tree.get("a/b").int_value() == 11 &&
+            tree.get("a/c").int_value() == 20 && tree.get("d").is_null(),
+        "the commit applies the writes in order");
+  check(b == std::vector<std::string>{"1>11"},
+        "a path written twice is notified once with its first and last value");
+  check(d == std::vector<std::string>{"3>null"}, "erased paths are notified");
+  check(parent.size() == 1, "the common ancestor is notified once");
+  check(tree.version() == version + 1, "the commit is one update");
+}
+
+void uncommittedWrites() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}});
+  auto a = std::vector<std::string>{};
+  auto c1 = observe(tree, "a", a);
+  {
+    auto transaction = tree.begin();
+    transaction.set("a", 2);
+  }
+  check(tree.get("a").int_value() == 1 && a.empty(),
+        "writes that are not committed are discarded");
+  auto transaction = tree.begin();
+  transaction.commit();
+  transaction.set("a", 3);
+  transaction.commit();
+  check(a == std::vector<std::string>{"1>3"},
+        "a transaction can be committed again");
+}
+
+int main() {
+  try {
+    onePass();
+    uncommittedWrites();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Slots of value type T connected with connect<T>()
+#include <otree/ObservableTree.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+void convertedValues() {
+  auto tree = Tree{};
+  auto changes = std::vector<std::pair<int, int>>{};
+  auto connection = tree.modificationSignal("a")->connect<int>(
+      [&changes](const int &oldValue, const int &newValue) {
+        changes.emplace_back(oldValue, newValue);
+      });
+  tree.set(Object{{"a", 1}});
+  check(changes == std::vector<std::pair<int, int>>{{0, 1}},
+        "the slot gets the converted values");
+  tree.set("a", 1.0);
+  tree.set("a", 1.4);
+  check(changes.size() == 1, "changes to equal values are dropped");
+  tree.set("a", 2);
+  check(changes.back() == std::pair<int, int>{1, 2},
+        "changes to other values are passed");
+}
+
+void sharedSlots() {
+  auto tree = Tree{};
+  auto signal = tree.modificationSignal("a");
+  auto ints = 0;
+  auto strings = std::vector<std::string>{};
+  auto c1 = signal->connect<int>([&ints](const int &, const int &) { ++ints; });
+  auto c2 = signal->connect<int>([&ints](const int &, const int &) { ++ints; });
+  auto c3 = signal->connect<std::string>(
+      [&strings](const std::string &, const std::string &newValue) {
+        strings.push_back(newValue);
+      });
+  tree.set(Object{{"a", "x"}});
+  check(ints == 0 && strings == std::vector<std::string>{"x"},
+        "each value type drops its own unchanged values");
+  tree.set("a", 3);
+  check(ints == 2 && strings.size() == 2 && strings.back().empty(),
+        "the slots of a value type are all called");
+  c1.disconnect();
+  tree.set("a", 4);
+  check(ints == 3, "a disconnected typed slot is not called");
+  c2.disconnect();
+  c3.disconnect();
+  signal.reset();
+  check(tree.prune().signals == 1,
+        "the last typed slots disconnect the slot of the signal");
+}
+
+int main() {
+  try {
+    convertedValues();
+    sharedSlots();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
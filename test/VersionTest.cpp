@@ -0,0 +1,63 @@
+// Versions of the tree and of its observed paths
+#include <otree/ObservableTree.h>
+
+#include <iostream>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+void pathVersions() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", Object{{"b", 1}}}, {"c", 1}});
+  auto a = tree.modificationSignal("a");
+  auto b = tree.modificationSignal("a/b");
+  auto created = tree.version();
+  check(tree.version("a/b") == created, "a signal starts at the tree version");
+  tree.set("c", 2);
+  check(tree.version() == created + 1 && tree.version("a/b") == created &&
+            tree.version("a") == created,
+        "writes elsewhere move only the tree version");
+  check(tree.version("c") == tree.version(),
+        "paths without a signal have the tree version");
+  tree.set("a/b", 1);
+  check(tree.version("a/b") == created, "writes of equal values do not count");
+  tree.set("a/b", 2);
+  check(tree.version("a/b") == tree.version() &&
+            tree.version("a") == tree.version(),
+        "a change moves the versions of the path and its observed ancestors");
+  tree.set(Object{{"a", Object{{"b", 3}}}, {"c", 2}});
+  check(tree.version("a/b") == tree.version(), "root updates move them too");
+}
+
+void handleVersions() {
+  auto tree = Tree{};
+  tree.set(Object{{"a", 1}});
+  auto handle = tree.resolve("a");
+  check(tree.version(handle) == tree.version(),
+        "an unobserved handle has the tree version");
+  auto signal = tree.modificationSignal("a");
+  auto observed = tree.version(handle);
+  tree.set("b", 1);
+  check(tree.version(handle) == observed,
+        "a handle follows the signals created after it");
+  tree.set(handle, 2);
+  check(tree.version(handle) == tree.version() &&
+            tree.version("a") == tree.version(handle),
+        "handle and path versions agree");
+}
+
+int main() {
+  try {
+    pathVersions();
+    handleVersions();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
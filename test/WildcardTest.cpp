@@ -0,0 +1,78 @@
+// Subscriptions with "*" and "**" keys
+#include <otree/ObservableTree.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Json11Trait.h"
+
+using namespace otree;
+
+using Tree = ObservableTree<json11::Json, Json11Trait>;
+using Object = json11::Json::object;
+
+// The matched paths recorded by observe(), whose order is unspecified
+std::vector<std::string> sorted(std::vector<std::string> matched) {
+  std::sort(matched.begin(), matched.end());
+  return matched;
+}
+
+// Records the matched paths of the slots of `path`
+auto observe(Tree &tree, const std::string &path,
+             std::vector<std::string> &matched) {
+  return tree.modificationSignal(path)->connect(
+      [&matched, path](const Path &at, const json11::Json &,
+                       const json11::Json &) {
+        matched.push_back(path + "@" + at.toString());
+      });
+}
+
+void childAndSubtree() {
+  auto tree = Tree{};
+  auto matched = std::vector<std::string>{};
+  auto c1 = observe(tree, "b/*", matched);
+  auto c2 = observe(tree, "b/**", matched);
+  tree.set(Object{{"b", Object{{"a", Object{{"c", 1}}}, {"d", 2}}}});
+  check(sorted(matched) == std::vector<std::string>{"b/**@b/a", "b/**@b/a/c",
+                                                    "b/**@b/d", "b/*@b/a",
+                                                    "b/*@b/d"},
+        "\"*\" matches the children, \"**\" the descendants too");
+  matched.clear();
+  tree.set("b/d", 3);
+  check(sorted(matched) == std::vector<std::string>{"b/**@b/d", "b/*@b/d"},
+        "a path update matches only the written child");
+  matched.clear();
+  tree.set("e", 1);
+  check(matched.empty(), "changes outside the prefix do not match");
+}
+
+void explicitNulls() {
+  auto tree = Tree{};
+  tree.set(Object{{"b", Object{{"a", Object{{"c", nullptr}}}}}});
+  auto matched = std::vector<std::string>{};
+  auto c1 = observe(tree, "b/a/*", matched);
+  auto c2 = observe(tree, "**", matched);
+  tree.set(Object{{"b", Object{{"a", Object{{"c", 1}}}}}});
+  auto once = std::vector<std::string>{"**@b", "**@b/a", "**@b/a/c",
+                                       "b/a/*@b/a/c"};
+  check(sorted(matched) == once,
+        "a null child replaced by a value matches once");
+  matched.clear();
+  tree.set(Object{{"b", Object{{"a", Object{{"c", nullptr}}}}}});
+  check(sorted(matched) == once,
+        "a value replaced by a null child matches once");
+}
+
+int main() {
+  try {
+    childAndSubtree();
+    explicitNulls();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -2,79 +2,14 @@
 
 #include <forward_list>
 #include <iostream>
-#include <json11/json11.hpp>
 #include <mutex>
 #include <sstream>
 #include <thread>
 #include <vector>
 
-using namespace otree;
-
-struct Json11Trait {
-  using JsonType = json11::Json;
-  template <typename T, typename = void>
-  struct Impl;
-
-  static JsonType get(const JsonType &j, const Path &kp) {
-    JsonType jret = j;
-    for (const auto &key : kp.keys()) {
-      if (jret = jret[key]; jret.is_null()) {
-        break;
-      }
-    }
-    return jret;
-  }
-
-  static void set(JsonType &j, const Path &kp, const JsonType &jvalue) {
-    //    throw std::exception{"Method is not supported!"};
-  }
-
-  static JsonType get(const JsonType &j, const Path::KeyType &key) {
-    return j[key];
-  }
-
-  static bool equal(const JsonType &j1, const JsonType &j2) { return j1 == j2; }
-
-  static bool empty(const JsonType &j) { return j.is_null(); }
-
-  template <typename T, typename = bool>
-  static T get(const JsonType &j, const Path &kp) {
-    return Impl<T>::get(Json11Trait::get(j, kp));
-  }
-
-  template <class RawType, class Type>
-  using IsTypeOf = std::enable_if_t<
-      std::is_same_v<RawType, std::remove_cv_t<std::remove_reference_t<Type>>>,
-      void>;
+#include "Json11Trait.h"
 
-  template <>
-  struct Impl<int> {
-    static int get(const JsonType &j) { return j.int_value(); }
-  };
-  template <>
-  struct Impl<double> {
-    static double get(const JsonType &j) { return j.number_value(); }
-  };
-  template <class String>
-  struct Impl<String, IsTypeOf<std::string, String>> {
-    static String get(const JsonType &j) { return j.string_value(); }
-  };
-
-  template <>
-  struct Impl<bool> {
-    static bool get(const JsonType &j) { return j.bool_value(); }
-  };
-
-  template <class Array>
-  struct Impl<Array, IsTypeOf<JsonType::array, Array>> {
-    static JsonType::array get(const JsonType &j) { return j.array_items(); }
-  };
-
-  template <class JsonObject>
-  struct Impl<JsonObject, IsTypeOf<JsonType::object, JsonObject>> {
-    static JsonObject get(const JsonType &j) { return j.object_items(); }
-  };
-};
+using namespace otree;
 
 struct Silencer {
   Silencer() = default;
@@ -110,102 +45,7 @@ void functionDump(json11::Json jold, json11::Json jnew) {
             << i << ".new = " << jnew.dump();
 }
 
-#include <boost/property_tree/info_parser.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/property_tree/ptree.hpp>
-#include <sstream>
-
-namespace pt = boost::property_tree;
-
-namespace otree {
-class PtreeTrait {
- public:
-  using NodeType = pt::ptree;
-  using PathType = pt::ptree::path_type;
-  using KeyType = pt::ptree::key_type;
-
-  static NodeType get(const NodeType &node, const PathType &path) {
-    try {
-      return node.get_child(path);
-    } catch (...) {
-      return {};
-    }
-  }
-
-  static void set(NodeType &node, const PathType &path, const NodeType &value) {
-    node.put_child(path, value);
-  }
-
-  static NodeType get(const NodeType &node, const KeyType &key) {
-    try {
-      return node.get_child(key);
-    } catch (...) {
-      return {};
-    }
-  }
-
-  static bool equal(const NodeType &node1, const NodeType &node2) {
-    return node1 == node2;
-  }
-
-  static bool empty(const NodeType &j) { return j.begin() == j.end(); }
-};
-
-class PPathIter {
-  using PathImpl = otree::Path;
-  using BaseIt = otree::Path::iterator;
-  std::shared_ptr<PathImpl> p;
-  int index = -1;
-
- public:
-  using ValueType = PathImpl::KeyType;
-
-  PPathIter(const PtreeTrait::PathType &ppath) : p{new PathImpl{ppath.dump()}} {
-    if (!p->keys().empty()) {
-      index = 0;
-    }
-  }
-
-  PPathIter() = default;
-
-  bool operator==(const PPathIter &otherIt) const {
-    return (p == otherIt.p && index == otherIt.index) ||
-           ((otherIt.index == -1) && (index == -1));
-  }
-
-  bool operator!=(const PPathIter &other) const { return !(*this == other); }
-
-  PPathIter &operator++() {
-    if (p && index != -1) {
-      if (static_cast<size_t>(index) < p->keys().size() - 1) {
-        ++index;
-      } else {
-        index = -1;
-      }
-    }
-    return *this;
-  }
-
-  PPathIter operator++(int) {
-    auto it = *this;
-    if (p && index != -1) {
-      if (static_cast<size_t>(index) < p->keys().size() - 1) {
-        ++index;
-      } else {
-        index = -1;
-      }
-    }
-    return it;
-  }
-
-  const ValueType &operator*() const { return p->keys()[index]; }
-};
-
-auto begin(const PtreeTrait::PathType &p) { return PPathIter{p}; }
-
-auto end(const PtreeTrait::PathType &p) { return PPathIter{}; }
-
-}  // namespace otree
+#include "PtreeTrait.h"
 
 using OPtree = otree::ObservableTree<PtreeTrait::NodeType, PtreeTrait,
                                      PtreeTrait::PathType, PtreeTrait::KeyType>;
@@ -230,8 +70,8 @@ int main() {
   pt::json_parser::read_json(iss1, jconfig1);
   pt::json_parser::read_json(iss2, jconfig2);
 
-  auto ptreedump = [](const OPtree::NodeType &jold,
-                      const OPtree::NodeType &jnew) {
+  auto ptreedump = []([[maybe_unused]] const OPtree::NodeType &jold,
+                      [[maybe_unused]] const OPtree::NodeType &jnew) {
     //    std::cout << "old = ";
     //    pt::write_info(std::cout, jold);
 
@@ -239,10 +79,11 @@ int main() {
     //    pt::write_info(std::cout, jnew);
   };
 
+  auto wildcardMatches = 0;
   {
     auto connection1 = config->modificationSignal("config/usb/enabled")
-                           ->connect([](const OPtree::NodeType &jold,
-                                        const OPtree::NodeType &jnew) {
+                           ->connect([](const OPtree::NodeType & /*jold*/,
+                                        const OPtree::NodeType & /*jnew*/) {
                              //              auto oldV =
                              //              jold.get_value_optional<int>();
                              //              auto newV =
@@ -257,6 +98,13 @@ int main() {
         config->modificationSignal("config/usb/enabled")->connect(ptreedump);
     auto connection3 =
         config->modificationSignal("config/usb/enabled")->connect(ptreedump);
+    auto connection4 =
+        config->modificationSignal("config/*/enabled")
+            ->connect([&wildcardMatches](const OPtree::PathType &,
+                                         const OPtree::NodeType &,
+                                         const OPtree::NodeType &) {
+              ++wildcardMatches;
+            });
     //    for (int i = 0; i < 2000; ++i)
     //      config->modificationSignal("config/usb/enabled")->connect(ptreedump);
 
@@ -276,5 +124,8 @@ int main() {
   //  }
 
   delete config;
-  return 0;
+  // both "enabled" keys are set first, then only usb's changes, on every set
+  // but the first of the loop
+  outstream << "wildcard matches: " << wildcardMatches;
+  return wildcardMatches == 2 + 2 * 100000 - 1 ? 0 : 1;
 }